@@ -0,0 +1,221 @@
+#include "stdafx.h"
+#include "cluster_graph.h"
+#include "sectors.h"
+
+static const double infinity = 1000000000;
+
+// Border openings longer than this get an entrance at each end instead of one in the middle.
+static const int maxSingleEntranceLength = 6;
+
+ClusterGraph::ClusterGraph(Rectangle b, int size) : bounds(b), clusterSize(size),
+    clusters(Rectangle((b.width() + size - 1) / size, (b.height() + size - 1) / size)) {
+}
+
+int ClusterGraph::getClusterSize() const {
+  return clusterSize;
+}
+
+Vec2 ClusterGraph::getClusterCoord(Vec2 pos) const {
+  return (pos - bounds.topLeft()) / clusterSize;
+}
+
+Rectangle ClusterGraph::getClusterBounds(Vec2 cluster) const {
+  Vec2 topLeft = bounds.topLeft() + cluster * clusterSize;
+  return Rectangle(topLeft, topLeft + Vec2(clusterSize, clusterSize)).intersection(bounds);
+}
+
+void ClusterGraph::invalidate(Vec2 pos) {
+  // Entrances on a cluster border depend on the tiles on both sides, so the neighbors of the tile are marked too.
+  auto mark = [&](Vec2 v) {
+    if (v.inRectangle(bounds))
+      clusters[getClusterCoord(v)].dirty = true;
+  };
+  mark(pos);
+  for (Vec2 v : pos.neighbors8())
+    mark(v);
+}
+
+ClusterGraph::Cluster& ClusterGraph::getCluster(Vec2 cluster, const Sectors& sectors, const CostFun& entryCost) {
+  if (clusters[cluster].dirty)
+    rebuild(cluster, sectors, entryCost);
+  return clusters[cluster];
+}
+
+vector<pair<Vec2, Vec2>> ClusterGraph::getCrossings(Vec2 cluster1, Vec2 cluster2, const Sectors& sectors) const {
+  // Always compute in the same orientation so that both clusters agree on the entrances of their common border.
+  if (cluster2 < cluster1) {
+    auto ret = getCrossings(cluster2, cluster1, sectors);
+    for (auto& elem : ret)
+      std::swap(elem.first, elem.second);
+    return ret;
+  }
+  vector<pair<Vec2, Vec2>> ret;
+  auto area = getClusterBounds(cluster1);
+  auto addOpenings = [&](const vector<Vec2>& border, Vec2 dir) {
+    int runStart = -1;
+    for (int i : Range(border.size() + 1)) {
+      bool open = i < border.size() && sectors.contains(border[i]) && sectors.contains(border[i] + dir);
+      if (open && runStart == -1)
+        runStart = i;
+      if (!open && runStart > -1) {
+        int runEnd = i - 1;
+        if (runEnd - runStart + 1 <= maxSingleEntranceLength) {
+          Vec2 v = border[(runStart + runEnd) / 2];
+          ret.push_back(make_pair(v, v + dir));
+        } else
+          for (int index : {runStart, runEnd})
+            ret.push_back(make_pair(border[index], border[index] + dir));
+        runStart = -1;
+      }
+    }
+  };
+  Vec2 dir = cluster2 - cluster1;
+  vector<Vec2> border;
+  if (dir == Vec2(1, 0)) {
+    for (int y : area.getYRange())
+      border.push_back(Vec2(area.right() - 1, y));
+  } else if (dir == Vec2(0, 1)) {
+    for (int x : area.getXRange())
+      border.push_back(Vec2(x, area.bottom() - 1));
+  } else if (dir == Vec2(1, 1))
+    border.push_back(area.bottomRight() - Vec2(1, 1));
+  else if (dir == Vec2(1, -1))
+    border.push_back(Vec2(area.right() - 1, area.top()));
+  addOpenings(border, dir);
+  return ret;
+}
+
+Table<double> ClusterGraph::getLocalCosts(Vec2 cluster, const Sectors& sectors, const CostFun& entryCost) const {
+  auto area = getClusterBounds(cluster);
+  Table<double> ret(area, infinity);
+  for (Vec2 v : area)
+    if (sectors.contains(v))
+      ret[v] = entryCost(v);
+  return ret;
+}
+
+void ClusterGraph::getLocalDistances(Vec2 from, const Table<double>& costs, Table<double>& distances) const {
+  auto& area = costs.getBounds();
+  for (Vec2 v : area)
+    distances[v] = infinity;
+  using QueueElem = pair<double, Vec2>;
+  priority_queue<QueueElem, vector<QueueElem>, std::greater<QueueElem>> q;
+  distances[from] = 0;
+  q.push(make_pair(0.0, from));
+  while (!q.empty()) {
+    auto elem = q.top();
+    q.pop();
+    if (elem.first > distances[elem.second])
+      continue;
+    for (Vec2 dir : Vec2::directions8()) {
+      Vec2 next = elem.second + dir;
+      if (next.inRectangle(area) && costs[next] < infinity) {
+        double dist = elem.first + costs[next];
+        if (dist < distances[next]) {
+          distances[next] = dist;
+          q.push(make_pair(dist, next));
+        }
+      }
+    }
+  }
+}
+
+void ClusterGraph::rebuild(Vec2 clusterCoord, const Sectors& sectors, const CostFun& entryCost) {
+  PROFILE;
+  auto& cluster = clusters[clusterCoord];
+  cluster.nodes.clear();
+  for (Vec2 dir : Vec2::directions8()) {
+    Vec2 neighbor = clusterCoord + dir;
+    if (neighbor.inRectangle(clusters.getBounds()))
+      for (auto& crossing : getCrossings(clusterCoord, neighbor, sectors))
+        cluster.nodes[crossing.first].push_back(Edge{crossing.second, entryCost(crossing.second)});
+  }
+  auto costs = getLocalCosts(clusterCoord, sectors, entryCost);
+  auto& area = costs.getBounds();
+  auto& extraConnections = sectors.getExtraConnections();
+  for (Vec2 v : area)
+    if (auto other = extraConnections[v])
+      if (sectors.contains(v) && sectors.contains(*other))
+        cluster.nodes[v].push_back(Edge{*other, entryCost(*other)});
+  auto entrances = getKeys(cluster.nodes);
+  std::sort(entrances.begin(), entrances.end());
+  Table<double> distances(area);
+  for (Vec2 v : entrances) {
+    getLocalDistances(v, costs, distances);
+    auto& edges = cluster.nodes[v];
+    for (Vec2 w : entrances)
+      if (w != v && distances[w] < infinity)
+        edges.push_back(Edge{w, distances[w]});
+  }
+  cluster.dirty = false;
+}
+
+optional<vector<Vec2>> ClusterGraph::findPath(Vec2 from, Vec2 to, const Sectors& sectors, const CostFun& entryCost,
+    int* numExpanded) {
+  PROFILE;
+  if (!sectors.same(from, to))
+    return none;
+  Vec2 fromCluster = getClusterCoord(from);
+  Vec2 toCluster = getClusterCoord(to);
+  auto fromCosts = getLocalCosts(fromCluster, sectors, entryCost);
+  Table<double> fromDistances(fromCosts.getBounds());
+  getLocalDistances(from, fromCosts, fromDistances);
+  if (fromCluster == toCluster && fromDistances[to] < infinity)
+    return vector<Vec2>{to};
+  auto toCosts = getLocalCosts(toCluster, sectors, entryCost);
+  auto& toArea = toCosts.getBounds();
+  Table<double> toDistances(toArea);
+  getLocalDistances(to, toCosts, toDistances);
+  using QueueElem = pair<double, Vec2>;
+  priority_queue<QueueElem, vector<QueueElem>, std::greater<QueueElem>> q;
+  unordered_map<Vec2, double, CustomHash<Vec2>> distance;
+  unordered_map<Vec2, Vec2, CustomHash<Vec2>> previous;
+  auto heuristic = [&](Vec2 v) { return double(v.dist8(to)); };
+  for (auto& node : getCluster(fromCluster, sectors, entryCost).nodes) {
+    double dist = fromDistances[node.first];
+    if (dist < infinity) {
+      distance[node.first] = dist;
+      previous[node.first] = from;
+      q.push(make_pair(dist + heuristic(node.first), node.first));
+    }
+  }
+  double best = infinity;
+  optional<Vec2> bestNode;
+  int expanded = 0;
+  while (!q.empty()) {
+    auto elem = q.top();
+    q.pop();
+    if (elem.first >= best)
+      break;
+    Vec2 node = elem.second;
+    double dist = distance.at(node);
+    if (elem.first > dist + heuristic(node))
+      continue;
+    ++expanded;
+    if (node.inRectangle(toArea) && dist + toDistances[node] < best) {
+      best = dist + toDistances[node];
+      bestNode = node;
+    }
+    auto& cluster = getCluster(getClusterCoord(node), sectors, entryCost);
+    if (auto edges = getReferenceMaybe(cluster.nodes, node))
+      for (auto& edge : *edges) {
+        double nextDist = dist + edge.cost;
+        auto it = distance.find(edge.to);
+        if (it == distance.end() || nextDist < it->second) {
+          distance[edge.to] = nextDist;
+          previous[edge.to] = node;
+          q.push(make_pair(nextDist + heuristic(edge.to), edge.to));
+        }
+      }
+  }
+  if (numExpanded)
+    *numExpanded += expanded;
+  if (!bestNode)
+    return none;
+  vector<Vec2> ret;
+  if (*bestNode != to)
+    ret.push_back(to);
+  for (Vec2 v = *bestNode; v != from; v = previous.at(v))
+    ret.push_back(v);
+  return ret.reverse();
+}
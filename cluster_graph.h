@@ -0,0 +1,46 @@
+#pragma once
+
+#include "util.h"
+
+class Sectors;
+
+/** Abstract graph used for long-range pathfinding. The level is split into square clusters, the graph nodes
+    are the tiles where a creature can cross from one cluster to another, and the edges store the cost
+    of walking between them inside a cluster. Clusters are rebuilt lazily after a tile inside or next to them
+    changes connectivity or navigation cost.*/
+class ClusterGraph {
+  public:
+  ClusterGraph(Rectangle bounds, int clusterSize = 16);
+
+  using CostFun = function<double(Vec2)>;
+
+  /** Marks the clusters that depend on the given tile for recalculation.*/
+  void invalidate(Vec2);
+
+  /** Returns the abstract route from one tile to another, as a list of waypoints ending with the target.
+      The source is not included. Returns none if the graph doesn't connect both tiles.*/
+  optional<vector<Vec2>> findPath(Vec2 from, Vec2 to, const Sectors&, const CostFun& entryCost,
+      int* numExpanded = nullptr);
+
+  int getClusterSize() const;
+
+  private:
+  struct Edge {
+    Vec2 to;
+    double cost;
+  };
+  struct Cluster {
+    bool dirty = true;
+    unordered_map<Vec2, vector<Edge>, CustomHash<Vec2>> nodes;
+  };
+  Vec2 getClusterCoord(Vec2) const;
+  Rectangle getClusterBounds(Vec2 cluster) const;
+  Cluster& getCluster(Vec2 cluster, const Sectors&, const CostFun&);
+  void rebuild(Vec2 cluster, const Sectors&, const CostFun&);
+  vector<pair<Vec2, Vec2>> getCrossings(Vec2 cluster1, Vec2 cluster2, const Sectors&) const;
+  Table<double> getLocalCosts(Vec2 cluster, const Sectors&, const CostFun&) const;
+  void getLocalDistances(Vec2 from, const Table<double>& costs, Table<double>& distances) const;
+  Rectangle bounds;
+  int clusterSize;
+  Table<Cluster> clusters;
+};
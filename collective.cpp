@@ -4,6 +4,7 @@
 #include "creature.h"
 #include "effect.h"
 #include "level.h"
+#include "shortest_path.h"
 #include "item.h"
 #include "item_factory.h"
 #include "statistics.h"
@@ -64,6 +65,7 @@
 #include "automaton_part.h"
 #include "item_fetch_info.h"
 #include "enemy_aggression_level.h"
+#include "subsystem_timer.h"
 
 template <class Archive>
 void Collective::serialize(Archive& ar, const unsigned int version) {
@@ -447,11 +449,26 @@ static int getKeeperUpgradeLevel(int dungeonLevel) {
 }
 
 void Collective::update(bool currentlyActive) {
+  updateLeaders();
+  control->update(currentlyActive);
+  updateImmigration(currentlyActive);
+}
+
+void Collective::updateRemote(int numTurns) {
+  updateLeaders();
+  control->updateRemote(numTurns);
+  // Immigration is driven by a timer, so it catches up on its own.
+  updateImmigration(false);
+}
+
+void Collective::updateLeaders() {
   for (auto leader : getLeaders()) {
     leader->upgradeViewId(getKeeperUpgradeLevel(dungeonLevel.level));
     name->viewId = leader->getViewObject().id();
   }
-  control->update(currentlyActive);
+}
+
+void Collective::updateImmigration(bool currentlyActive) {
   if (config->hasImmigrantion(currentlyActive) && (!getLeaders().empty() || !hadALeader) && !isConquered())
     immigration->update();
 }
@@ -522,6 +539,7 @@ void Collective::updateAutomatonEngines() {
 
 void Collective::tick() {
   PROFILE_BLOCK("Collective::tick");
+  SubsystemTimer timer(Subsystem::COLLECTIVE_TICK);
   updateBorderTiles();
   considerRebellion();
   updateGuardTasks();
@@ -1221,28 +1239,13 @@ void Collective::delayDangerousTasks(const vector<Position>& enemyPos1, LocalTim
     vector<Vec2> enemyPos = enemyPos1
         .filter([=] (const Position& p) { return p.isSameLevel(level); })
         .transform([] (const Position& p) { return p.getCoord();});
-    int infinity = 1000000;
     int radius = 10;
-    Table<int> dist(Rectangle::boundingBox(enemyPos)
+    auto bounds = Rectangle::boundingBox(enemyPos)
         .minusMargin(-radius)
-        .intersection(level->getBounds()), infinity);
-    queue<Vec2> q;
-    for (Vec2 v : enemyPos) {
-      dist[v] = 0;
-      q.push(v);
-    }
-    while (!q.empty()) {
-      Vec2 pos = q.front();
-      q.pop();
-      delayedPos[Position(pos, level)] = delayTime;
-      if (dist[pos] >= radius)
-        continue;
-      for (Vec2 v : pos.neighbors8())
-        if (v.inRectangle(dist.getBounds()) && dist[v] == infinity && territory->contains(Position(v, level))) {
-          dist[v] = dist[pos] + 1;
-          q.push(v);
-        }
-    }
+        .intersection(level->getBounds());
+    BfSearch::visit(PathfindingContext::forThisThread(), bounds, enemyPos, radius,
+        [&](Vec2 v) { return territory->contains(Position(v, level)); },
+        [&](Vec2 v, int) { delayedPos[Position(v, level)] = delayTime; });
   }
 }
 
@@ -67,6 +67,8 @@ class Collective : public TaskCallback, public UniqueEntity<Collective>, public
   void makeConqueredRetired(Collective* conqueror);
   void tick();
   void update(bool currentlyActive);
+  /** Updates the collective in a model that the player isn't in, covering a number of turns at once.*/
+  void updateRemote(int numTurns);
   TribeId getTribeId() const;
   Tribe* getTribe() const;
   WModel getModel() const;
@@ -254,6 +256,8 @@ class Collective : public TaskCallback, public UniqueEntity<Collective>, public
   private:
   void onMinionKilled(Creature* victim, Creature* killer);
   void onKilledSomeone(Creature* victim, Creature* killer);
+  void updateLeaders();
+  void updateImmigration(bool currentlyActive);
 
   void fetchItems(Position, const ItemFetchInfo&);
 
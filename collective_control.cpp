@@ -12,6 +12,10 @@ CollectiveControl::CollectiveControl(Collective* c) : collective(c) {
 void CollectiveControl::update(bool currentlyActive) {
 }
 
+void CollectiveControl::updateRemote(int numTurns) {
+  update(false);
+}
+
 void CollectiveControl::tick() {
 }
 
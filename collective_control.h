@@ -13,6 +13,8 @@ class CollectiveControl : public OwnedObject<CollectiveControl> {
   public:
   CollectiveControl(Collective*);
   virtual void update(bool currentlyActive);
+  /** Called every few turns instead of update() when the player is in another model.*/
+  virtual void updateRemote(int numTurns);
   virtual void tick();
   virtual void onMemberKilled(const Creature* victim, const Creature* killer);
   virtual void onOtherKilled(const Creature* victim, const Creature* killer);
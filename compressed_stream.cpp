@@ -0,0 +1,489 @@
+#include "stdafx.h"
+#include "compressed_stream.h"
+
+static const int blockSize = 1 << 20;
+static const int dictionarySize = 1 << 15;
+static const int maxThreads = 8;
+static const int minChunkSize = 1 << 14;
+static const int maxChunkSize = 1 << 18;
+// The top bits of the rolling hash depend on the last 64 bytes. Requiring 16 of them to be zero gives
+// chunks of 64 KB on average.
+static const unsigned long long chunkBoundaryMask = 0xffffull << 48;
+
+static void writeLittleEndian(string& out, uLong value) {
+  for (int i : Range(4))
+    out += char((value >> (8 * i)) & 0xff);
+}
+
+// Increased when the format of the chunk index changes, so an old one is ignored.
+static const int chunkIndexVersion = 2;
+
+string getChunkIndexPath(const string& path) {
+  return path + ".chunks";
+}
+
+static unsigned long long mixBits(unsigned long long x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+static const unsigned long long* getGearTable() {
+  static const auto table = [] {
+    std::array<unsigned long long, 256> ret;
+    for (int i : Range(256))
+      ret[i] = mixBits(i + 1);
+    return ret;
+  }();
+  return table.data();
+}
+
+// Returns the end of the chunk that starts at the given index, or none if more data is needed to tell.
+static optional<size_t> findChunkEnd(const string& data, size_t begin, size_t end) {
+  auto gear = getGearTable();
+  unsigned long long hash = 0;
+  size_t limit = min(end, begin + maxChunkSize);
+  for (size_t i = begin + minChunkSize - 64; i < limit; ++i) {
+    hash = (hash << 1) + gear[(unsigned char) data[i]];
+    if (i + 1 >= begin + minChunkSize && !(hash & chunkBoundaryMask))
+      return i + 1;
+  }
+  if (limit == begin + maxChunkSize)
+    return limit;
+  return none;
+}
+
+static unsigned long long hashChunk(const string& data) {
+  unsigned long long hash = data.size();
+  size_t i = 0;
+  for (; i + 8 <= data.size(); i += 8) {
+    unsigned long long word;
+    memcpy(&word, data.data() + i, 8);
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29;
+  }
+  for (; i < data.size(); ++i)
+    hash = (hash ^ (unsigned char) data[i]) * 0x9e3779b97f4a7c15ull;
+  return mixBits(hash);
+}
+
+CompressedOutputBuffer::CompressedOutputBuffer(const char* path, int numThreads)
+    : CompressedOutputBuffer(path, nullptr, numThreads) {
+}
+
+CompressedOutputBuffer::CompressedOutputBuffer(const char* p, const char* previousPath, int numThreads)
+    : path(p), file(p, std::ios::out | std::ios::binary), crc(crc32(0, Z_NULL, 0)) {
+  if (previousPath) {
+    chunked = true;
+    loadPreviousChunks(previousPath);
+  } else
+    // A stale index would point to the wrong data.
+    remove(getChunkIndexPath(path).c_str());
+  if (numThreads <= 0)
+    numThreads = min<int>(maxThreads, thread::hardware_concurrency());
+  buffer.resize(blockSize);
+  setp(&buffer[0], &buffer[0] + buffer.size());
+  if (numThreads > 1)
+    for (int i : Range(numThreads))
+      workers.push_back(thread([this] { workerLoop(); }));
+}
+
+CompressedOutputBuffer::~CompressedOutputBuffer() {
+  close();
+}
+
+bool CompressedOutputBuffer::isOpen() const {
+  return file.is_open();
+}
+
+long long CompressedOutputBuffer::getNumReusedBytes() const {
+  return numReusedBytes;
+}
+
+// The extra field of the gzip header holds a single subfield with its own id and length.
+static const char headerFieldId[] = {'K', 'R'};
+static const int maxHeaderSize = 0xffff - 4;
+
+bool CompressedOutputBuffer::setHeader(const string& data) {
+  CHECK(!headerWritten) << "The header must be set before any data is written";
+  if (data.size() > maxHeaderSize)
+    return false;
+  header = data;
+  return true;
+}
+
+void CompressedOutputBuffer::writeHeader() {
+  headerWritten = true;
+  // Magic number, deflate, extra field flag, no modification time, no extra flags, unknown OS.
+  string out = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+  if (!header.empty()) {
+    out[3] = 4;
+    auto writeShort = [&](size_t value) {
+      out += char(value & 0xff);
+      out += char((value >> 8) & 0xff);
+    };
+    writeShort(header.size() + 4);
+    out.append(headerFieldId, 2);
+    writeShort(header.size());
+    out += header;
+    header = string();
+  }
+  file.write(out.data(), out.size());
+  fileSize += out.size();
+}
+
+void CompressedOutputBuffer::loadPreviousChunks(const char* previousPath) {
+  try {
+    std::ifstream indexFile(getChunkIndexPath(previousPath), std::ios::binary);
+    if (!indexFile)
+      return;
+    InputArchive archive(indexFile);
+    int version;
+    archive(version);
+    if (version != chunkIndexVersion)
+      return;
+    long long previousSize;
+    vector<CompressedChunk> previous;
+    archive(previousSize, previous);
+    previousFile.open(previousPath, std::ios::binary | std::ios::ate);
+    // The index is ignored if the file was replaced without it.
+    if (!previousFile || (long long) previousFile.tellg() != previousSize) {
+      previousFile.close();
+      return;
+    }
+    for (auto& chunk : previous)
+      previousChunks[chunk.hash] = chunk;
+  } catch (std::exception&) {
+    previousChunks.clear();
+  }
+}
+
+void CompressedOutputBuffer::compress(Block& block) {
+  z_stream stream {};
+  // Negative window bits produce raw deflate data without a zlib header.
+  CHECK(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+  if (!block.dictionary.empty())
+    deflateSetDictionary(&stream, (const Bytef*) block.dictionary.data(), (uInt) block.dictionary.size());
+  stream.next_in = (Bytef*) block.input.data();
+  stream.avail_in = (uInt) block.input.size();
+  // Non-final blocks end with a sync flush, which aligns them to a byte boundary, so they can be concatenated.
+  int flush = block.last ? Z_FINISH : Z_SYNC_FLUSH;
+  block.output.resize(deflateBound(&stream, block.input.size()) + 16);
+  while (true) {
+    if (stream.total_out == block.output.size())
+      block.output.resize(block.output.size() * 2);
+    stream.next_out = (Bytef*) &block.output[stream.total_out];
+    stream.avail_out = (uInt) (block.output.size() - stream.total_out);
+    int res = deflate(&stream, flush);
+    CHECK(res == Z_OK || res == Z_STREAM_END || res == Z_BUF_ERROR) << "Deflate error " << res;
+    if (block.last ? res == Z_STREAM_END : stream.avail_out > 0)
+      break;
+  }
+  block.output.resize(stream.total_out);
+  block.compressedCrc = crc32(0, (const Bytef*) block.output.data(), (uInt) block.output.size());
+  deflateEnd(&stream);
+  block.input = string();
+  block.dictionary = string();
+}
+
+void CompressedOutputBuffer::process(Block& block) const {
+  block.inputSize = block.input.size();
+  block.crc = crc32(0, (const Bytef*) block.input.data(), (uInt) block.input.size());
+  if (chunked && !block.last) {
+    block.hash = hashChunk(block.input);
+    if (auto chunk = getValueMaybe(previousChunks, block.hash))
+      if (chunk->crc == block.crc && chunk->size == block.inputSize) {
+        // The data is kept in case the chunk can't be read from the previous file.
+        block.reused = *chunk;
+        return;
+      }
+  }
+  compress(block);
+}
+
+void CompressedOutputBuffer::workerLoop() {
+  while (true) {
+    shared_ptr<Block> block;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      workAvailable.wait(lock, [this] { return stopping || !queued.empty(); });
+      if (queued.empty())
+        return;
+      block = queued.front();
+      queued.pop_front();
+    }
+    process(*block);
+    std::lock_guard<std::mutex> lock(mutex);
+    block->done = true;
+    blockDone.notify_all();
+  }
+}
+
+void CompressedOutputBuffer::cutChunks(bool last) {
+  size_t size = pptr() - pbase();
+  size_t begin = 0;
+  while (auto end = findChunkEnd(buffer, begin, size)) {
+    submitBlock(buffer.substr(begin, *end - begin), false);
+    begin = *end;
+  }
+  if (last) {
+    if (begin < size)
+      submitBlock(buffer.substr(begin, size - begin), false);
+    // Chunks may be copied to any place in a later file, so the stream is terminated by an empty block.
+    submitBlock("", true);
+    setp(&buffer[0], &buffer[0] + buffer.size());
+  } else {
+    buffer.erase(0, begin);
+    buffer.resize(blockSize);
+    setp(&buffer[0], &buffer[0] + buffer.size());
+    pbump(int(size - begin));
+  }
+}
+
+void CompressedOutputBuffer::submitBlock(string input, bool last) {
+  auto block = make_shared<Block>();
+  block->input = std::move(input);
+  block->last = last;
+  if (!chunked) {
+    block->dictionary = std::move(dictionary);
+    dictionary = block->input.substr(block->input.size() - min<size_t>(block->input.size(), dictionarySize));
+  }
+  if (workers.empty()) {
+    process(*block);
+    block->done = true;
+    unwritten.push_back(block);
+  } else {
+    std::lock_guard<std::mutex> lock(mutex);
+    unwritten.push_back(block);
+    queued.push_back(block);
+    workAvailable.notify_one();
+  }
+  writeFinishedBlocks(last);
+}
+
+void CompressedOutputBuffer::writeFinishedBlocks(bool all) {
+  // Limits the memory held by blocks waiting for compression or for their turn to be written.
+  const int maxUnwritten = 2 * max<int>(1, workers.size());
+  while (!unwritten.empty()) {
+    auto block = unwritten.front();
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!block->done && !all && unwritten.size() <= maxUnwritten)
+        break;
+      blockDone.wait(lock, [&] { return block->done; });
+    }
+    writeBlock(*block);
+    unwritten.pop_front();
+  }
+  if (!file)
+    failed = true;
+}
+
+void CompressedOutputBuffer::writeBlock(Block& block) {
+  if (!headerWritten)
+    writeHeader();
+  if (block.reused) {
+    block.output.resize(block.reused->compressedSize);
+    previousFile.seekg(block.reused->offset);
+    if (previousFile.read(&block.output[0], block.output.size()) && block.reused->compressedCrc ==
+        crc32(0, (const Bytef*) block.output.data(), (uInt) block.output.size())) {
+      block.compressedCrc = block.reused->compressedCrc;
+      numReusedBytes += block.inputSize;
+      block.input = string();
+    } else {
+      previousFile.clear();
+      compress(block);
+    }
+  }
+  crc = crc32_combine(crc, block.crc, (z_off_t) block.inputSize);
+  totalSize += block.inputSize;
+  if (chunked && !block.last)
+    chunks.push_back(CompressedChunk{block.hash, std::uint32_t(block.crc), std::uint32_t(block.inputSize), fileSize,
+        std::uint32_t(block.output.size()), std::uint32_t(block.compressedCrc)});
+  file.write(block.output.data(), block.output.size());
+  fileSize += block.output.size();
+}
+
+int CompressedOutputBuffer::overflow(int c) {
+  if (closed || failed)
+    return EOF;
+  if (chunked)
+    cutChunks(false);
+  else {
+    submitBlock(buffer.substr(0, pptr() - pbase()), false);
+    setp(&buffer[0], &buffer[0] + buffer.size());
+  }
+  if (c != EOF) {
+    *pptr() = char(c);
+    pbump(1);
+  }
+  return failed ? EOF : 0;
+}
+
+int CompressedOutputBuffer::sync() {
+  return failed ? -1 : 0;
+}
+
+bool CompressedOutputBuffer::close() {
+  if (closed)
+    return !failed;
+  closed = true;
+  if (isOpen()) {
+    if (chunked)
+      cutChunks(true);
+    else
+      submitBlock(buffer.substr(0, pptr() - pbase()), true);
+    string trailer;
+    writeLittleEndian(trailer, crc);
+    writeLittleEndian(trailer, uLong(totalSize & 0xffffffff));
+    file.write(trailer.data(), trailer.size());
+    fileSize += trailer.size();
+    file.close();
+    if (!file)
+      failed = true;
+  } else
+    failed = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    workAvailable.notify_all();
+  }
+  for (auto& worker : workers)
+    worker.join();
+  if (chunked && !failed) {
+    std::ofstream indexFile(getChunkIndexPath(path), std::ios::binary);
+    OutputArchive archive(indexFile);
+    archive(chunkIndexVersion, fileSize, chunks);
+  }
+  return !failed;
+}
+
+static const int firstChunkSize = 1 << 16;
+static const int chunkSize = 1 << 20;
+static const int maxChunksAhead = 4;
+
+CompressedInputBuffer::CompressedInputBuffer(const char* path) : file(gzopen(path, "rb")) {
+  if (file)
+    gzbuffer(file, 1 << 17);
+  setg(nullptr, nullptr, nullptr);
+}
+
+CompressedInputBuffer::~CompressedInputBuffer() {
+  if (readerStarted) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      chunkTaken.notify_all();
+    }
+    reader.join();
+  }
+  if (file)
+    gzclose(file);
+}
+
+bool CompressedInputBuffer::isOpen() const {
+  return !!file;
+}
+
+void CompressedInputBuffer::readerLoop() {
+  while (true) {
+    string chunk(chunkSize, 0);
+    int num = gzread(file, &chunk[0], chunkSize);
+    std::unique_lock<std::mutex> lock(mutex);
+    if (num <= 0) {
+      finished = true;
+      chunkReady.notify_all();
+      return;
+    }
+    chunk.resize(num);
+    chunks.push_back(std::move(chunk));
+    chunkReady.notify_all();
+    chunkTaken.wait(lock, [this] { return stopping || chunks.size() < maxChunksAhead; });
+    if (stopping)
+      return;
+  }
+}
+
+int CompressedInputBuffer::underflow() {
+  if (gptr() < egptr())
+    return (unsigned char) *gptr();
+  if (!file)
+    return EOF;
+  if (!readerStarted && !eback()) {
+    buffer.resize(firstChunkSize);
+    int num = gzread(file, &buffer[0], firstChunkSize);
+    if (num <= 0)
+      return EOF;
+    buffer.resize(num);
+  } else {
+    if (!readerStarted) {
+      readerStarted = true;
+      reader = thread([this] { readerLoop(); });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    chunkReady.wait(lock, [this] { return finished || !chunks.empty(); });
+    if (chunks.empty())
+      return EOF;
+    buffer = std::move(chunks.front());
+    chunks.pop_front();
+    chunkTaken.notify_all();
+  }
+  setg(&buffer[0], &buffer[0], &buffer[0] + buffer.size());
+  return (unsigned char) *gptr();
+}
+
+optional<string> readCompressedFileHeader(const char* path) {
+  std::ifstream file(path, std::ios::binary);
+  // The header is at most 64 KB, so it's read at once.
+  string data(10 + 2 + 4 + maxHeaderSize, 0);
+  file.read(&data[0], data.size());
+  data.resize(file.gcount());
+  auto readShort = [&](size_t index) {
+    return size_t((unsigned char) data[index]) | (size_t((unsigned char) data[index + 1]) << 8);
+  };
+  if (data.size() < 16 || data[0] != '\x1f' || data[1] != '\x8b' || !(data[3] & 4))
+    return none;
+  size_t extraEnd = min(data.size(), 12 + readShort(10));
+  for (size_t index = 12; index + 4 <= extraEnd; index += 4 + readShort(index + 2)) {
+    size_t size = readShort(index + 2);
+    if (data[index] == headerFieldId[0] && data[index + 1] == headerFieldId[1] && index + 4 + size <= extraEnd)
+      return data.substr(index + 4, size);
+  }
+  return none;
+}
+
+bool isCompressedFileValid(const char* path) {
+  auto file = gzopen(path, "rb");
+  if (!file)
+    return false;
+  string buffer(chunkSize, 0);
+  int num;
+  while ((num = gzread(file, &buffer[0], chunkSize)) > 0) {}
+  // Reading an uncompressed file would succeed, so it's checked that the data was actually inflated.
+  bool compressed = !gzdirect(file);
+  // Reports an error if the file ended in the middle of the gzip stream.
+  return gzclose(file) == Z_OK && num == 0 && compressed;
+}
+
+CompressedOutputStream::CompressedOutputStream(const char* path, const char* previousPath)
+    : std::ostream(&buffer), buffer(path, previousPath) {
+  if (!buffer.isOpen())
+    setstate(std::ios::badbit);
+}
+
+bool CompressedOutputStream::setHeader(const string& data) {
+  return buffer.setHeader(data);
+}
+
+bool CompressedOutputStream::close() {
+  if (!buffer.close()) {
+    setstate(std::ios::badbit);
+    return false;
+  }
+  return good();
+}
+
+CompressedInputStream::CompressedInputStream(const char* path) : std::istream(&buffer), buffer(path) {
+  if (!buffer.isOpen())
+    setstate(std::ios::badbit);
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "util.h"
+#include <zlib.h>
+
+/** A piece of a file written in chunks. It's compressed independently of the other chunks, so it can be copied
+    into a later file.*/
+struct CompressedChunk {
+  unsigned long long SERIAL(hash);
+  std::uint32_t SERIAL(crc);
+  std::uint32_t SERIAL(size);
+  long long SERIAL(offset);
+  std::uint32_t SERIAL(compressedSize);
+  // Checked before the compressed bytes are copied, in case the file was replaced by another one.
+  std::uint32_t SERIAL(compressedCrc);
+  SERIALIZE_ALL(hash, crc, size, offset, compressedSize, compressedCrc)
+};
+
+/** Returns the file that lists the chunks of the given file.*/
+string getChunkIndexPath(const string& path);
+
+/** Writes a gzip file using large blocks that are deflated in parallel, like pigz. Every block is primed with
+    the end of the previous one, so the compression ratio stays close to a single deflate stream. The result
+    is a regular gzip file.*/
+class CompressedOutputBuffer : public std::streambuf {
+  public:
+  CompressedOutputBuffer(const char* path, int numThreads = 0);
+  /** Cuts the data into chunks at content-defined boundaries, so data that didn't change since the previous
+      file produces the same chunks, even if it moved. Chunks listed in the index of the previous file are copied
+      from it instead of being compressed again. The index of the new file is written next to it.*/
+  CompressedOutputBuffer(const char* path, const char* previousPath, int numThreads = 0);
+  ~CompressedOutputBuffer();
+
+  bool isOpen() const;
+
+  /** Compresses the remaining data and writes the gzip trailer. Returns false if anything failed.*/
+  bool close();
+
+  /** Returns the number of bytes that were copied from the previous file.*/
+  long long getNumReusedBytes() const;
+
+  /** Stores the data uncompressed in the extra field of the gzip header, see readCompressedFileHeader. It must be
+      called before the first block is written. Returns false if the data doesn't fit.*/
+  bool setHeader(const string&);
+
+  protected:
+  virtual int overflow(int c) override;
+  /** Doesn't force out a partial block, as that would hurt the compression.*/
+  virtual int sync() override;
+
+  private:
+  struct Block {
+    string input;
+    string dictionary;
+    bool last;
+    size_t inputSize;
+    string output;
+    uLong crc;
+    uLong compressedCrc = 0;
+    unsigned long long hash = 0;
+    optional<CompressedChunk> reused;
+    bool done = false;
+  };
+  static void compress(Block&);
+  void process(Block&) const;
+  void cutChunks(bool last);
+  void submitBlock(string input, bool last);
+  void writeFinishedBlocks(bool all);
+  void writeBlock(Block&);
+  void loadPreviousChunks(const char* previousPath);
+  void workerLoop();
+  void writeHeader();
+  string path;
+  string header;
+  bool headerWritten = false;
+  std::ofstream file;
+  long long fileSize = 0;
+  string buffer;
+  string dictionary;
+  uLong crc;
+  unsigned long long totalSize = 0;
+  bool failed = false;
+  bool closed = false;
+  bool chunked = false;
+  std::ifstream previousFile;
+  unordered_map<unsigned long long, CompressedChunk> previousChunks;
+  vector<CompressedChunk> chunks;
+  long long numReusedBytes = 0;
+  std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable blockDone;
+  bool stopping = false;
+  deque<shared_ptr<Block>> queued;
+  deque<shared_ptr<Block>> unwritten;
+  vector<thread> workers;
+};
+
+/** Reads a gzip or an uncompressed file. After the first chunk the decompression continues on a separate thread
+    ahead of the reader, so quick peeks at the start of a file stay cheap.*/
+class CompressedInputBuffer : public std::streambuf {
+  public:
+  CompressedInputBuffer(const char* path);
+  ~CompressedInputBuffer();
+
+  bool isOpen() const;
+
+  protected:
+  virtual int underflow() override;
+
+  private:
+  void readerLoop();
+  gzFile file;
+  string buffer;
+  bool readerStarted = false;
+  std::mutex mutex;
+  std::condition_variable chunkReady;
+  std::condition_variable chunkTaken;
+  deque<string> chunks;
+  bool finished = false;
+  bool stopping = false;
+  thread reader;
+};
+
+/** Returns the data stored with CompressedOutputBuffer::setHeader, reading only the start of the file.*/
+optional<string> readCompressedFileHeader(const char* path);
+
+/** Decompresses the whole file and checks that it's a complete gzip file with a matching CRC and length.*/
+bool isCompressedFileValid(const char* path);
+
+class CompressedOutputStream : public std::ostream {
+  public:
+  /** If the previous file is given, the data is written in chunks that reuse the ones of the previous file,
+      see CompressedOutputBuffer.*/
+  CompressedOutputStream(const char* path, const char* previousPath = nullptr);
+
+  bool setHeader(const string&);
+  /** Writes the rest of the file. Returns false if anything failed while writing it.*/
+  bool close();
+
+  private:
+  CompressedOutputBuffer buffer;
+};
+
+class CompressedInputStream : public std::istream {
+  public:
+  CompressedInputStream(const char* path);
+
+  private:
+  CompressedInputBuffer buffer;
+};
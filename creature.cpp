@@ -1084,8 +1084,43 @@ void Creature::considerMovingFromInaccessibleSquare() {
       }
 }
 
+// Dormant creatures still get a full tick once in a while, so that their view object catches up with changes
+// that don't update it right away.
+static const int dormantRefreshInterval = 10;
+
+static bool verifyDormantTicks = false;
+
+void Creature::setVerifyDormantTicks(bool verify) {
+  verifyDormantTicks = verify;
+}
+
+bool Creature::isDormant() const {
+  return !capture && equipment->isEmpty() && shamanSummons.empty() &&
+      attributes->getSkills().getValue(SkillId::SHAMANISM) == 0 && !attributes->hasTickingEffects();
+}
+
 void Creature::tick() {
   PROFILE_BLOCK("Creature::tick");
+  auto time = *getGlobalTime();
+  bool dormant = isDormant() && (time.getVisibleInt() + getUniqueId().getGenericId()) % dormantRefreshInterval != 0;
+  tickBookkeeping(time);
+  if (dormant && !verifyDormantTicks) {
+    modViewObject().setAttribute(ViewObject::Attribute::MORALE, getMorale());
+    getPosition().setNeedsRenderUpdate(true);
+    if (getBody().tick(this))
+      dieWithAttacker(lastAttacker);
+    return;
+  }
+  auto getState = [this] {
+    return make_tuple(morale, position, getBody().getHealth(), equipment->getItems().size(), isDead());
+  };
+  auto stateBefore = getState();
+  tickWork(time);
+  if (dormant)
+    CHECK(getState() == stateBefore) << "Dormant creature changed during tick: " << identify();
+}
+
+void Creature::tickBookkeeping(GlobalTime time) {
   addMorale(-morale * 0.0008);
   auto updateMorale = [this](Position pos, double mult) {
     for (auto& f : pos.getFurniture()) {
@@ -1106,22 +1141,25 @@ void Creature::tick() {
   }
   considerMovingFromInaccessibleSquare();
   captureHealth = min(1.0, captureHealth + 0.02);
-  auto time = *getGlobalTime();
   vision->update(this, time);
   if (Random.roll(5))
     getDifficultyPoints();
+}
+
+void Creature::tickWork(GlobalTime time) {
   equipment->tick(position, this);
   if (isDead())
     return;
   tickShamanSummons();
-  for (LastingEffect effect : ENUM_ALL(LastingEffect)) {
+  for (LastingEffect effect : attributes->popTimedOutEffects(time)) {
     if (attributes->considerTimeout(effect, time))
       LastingEffects::onTimedOut(this, effect, true);
     if (isDead())
       return;
+  }
+  for (LastingEffect effect : attributes->getTickingEffects())
     if (isAffected(effect, time) && LastingEffects::tick(this, effect))
       return;
-  }
   updateViewObject();
   if (getBody().tick(this)) {
     dieWithAttacker(lastAttacker);
@@ -1706,6 +1744,7 @@ void Creature::increaseExpLevel(ExperienceType type, double increase) {
   getAttributes().increaseExpLevel(type, increase);
   int newLevel = (int)getAttributes().getExpLevel(type);
   if (curLevel != newLevel) {
+    updateViewObject();
     you(MsgType::ARE, "more skilled");
     addPersonalEvent(getName().a() + " reaches " + ::getNameLowerCase(type) + " training level " + toString(newLevel));
     spellMap->onExpLevelReached(this, type, newLevel);
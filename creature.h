@@ -106,6 +106,11 @@ class Creature : public Renderable, public UniqueEntity<Creature>, public OwnedO
   bool canSee(Vec2) const;
   bool isEnemy(const Creature*) const;
   void tick();
+  /** A dormant creature has nothing to do on its tick besides updating morale and vision, so most of the
+      tick is skipped.*/
+  bool isDormant() const;
+  /** Makes dormant creatures run the full tick and check that it didn't change anything.*/
+  static void setVerifyDormantTicks(bool);
   void upgradeViewId(int level);
   ViewId getMaxViewIdUpgrade() const;
 
@@ -366,6 +371,8 @@ class Creature : public Renderable, public UniqueEntity<Creature>, public OwnedO
   optional<ViewId> SERIAL(primaryViewId);
   vector<Creature*> SERIAL(shamanSummons);
   void tickShamanSummons();
+  void tickBookkeeping(GlobalTime);
+  void tickWork(GlobalTime);
   bool considerSavingLife(DropType, const Creature* attacker);
   vector<AdjectiveInfo> getSpecialAttrAdjectives(bool good) const;
   vector<AutomatonPart> SERIAL(automatonParts);
@@ -36,6 +36,25 @@ void CreatureAttributes::initializeLastingEffects() {
   for (auto effect : ENUM_ALL(LastingEffect))
     if (body->isIntrinsicallyAffected(effect))
       ++permanentEffects[effect];
+  updateEffectSets();
+}
+
+void CreatureAttributes::updateEffectSets() {
+  permanentEffectSet.clear();
+  timedEffects.clear();
+  timeouts.clear();
+  for (auto effect : ENUM_ALL(LastingEffect)) {
+    updatePermanentEffect(effect);
+    if (lastingEffects[effect] > GlobalTime(0)) {
+      timedEffects.insert(effect);
+      timeouts.push_back(make_pair(lastingEffects[effect], effect));
+    }
+  }
+  std::make_heap(timeouts.begin(), timeouts.end(), std::greater<pair<GlobalTime, LastingEffect>>());
+}
+
+void CreatureAttributes::updatePermanentEffect(LastingEffect effect) {
+  permanentEffectSet.set(effect, permanentEffects[effect] > 0);
 }
 
 void CreatureAttributes::randomize() {
@@ -76,6 +95,8 @@ void CreatureAttributes::serializeImpl(Archive& ar, const unsigned int version)
 template <class Archive>
 void CreatureAttributes::serialize(Archive& ar, const unsigned int version) {
   serializeImpl(ar, version);
+  if (Archive::is_loading::value)
+    updateEffectSets();
 }
 
 SERIALIZABLE(CreatureAttributes);
@@ -215,9 +236,11 @@ void CreatureAttributes::add(BodyPart p, int count) {
     if (body->isIntrinsicallyAffected(effect))
       --permanentEffects[effect];
   body->addWithoutUpdatingPermanentEffects(p, count);
-  for (auto effect : ENUM_ALL(LastingEffect))
+  for (auto effect : ENUM_ALL(LastingEffect)) {
     if (body->isIntrinsicallyAffected(effect))
       ++permanentEffects[effect];
+    updatePermanentEffect(effect);
+  }
 }
 
 optional<string> CreatureAttributes::getPetReaction(const Creature* me) const {
@@ -249,7 +272,7 @@ bool CreatureAttributes::isAffected(LastingEffect effect, GlobalTime time) const
   if (auto suppressor = LastingEffects::getSuppressor(effect))
     if (isAffected(*suppressor, time))
       return false;
-  return lastingEffects[effect] > time || isAffectedPermanently(effect);
+  return lastingEffects[effect] > time || permanentEffectSet.contains(effect);
 }
 
 GlobalTime CreatureAttributes::getTimeOut(LastingEffect effect) const {
@@ -264,10 +287,47 @@ bool CreatureAttributes::considerTimeout(LastingEffect effect, GlobalTime curren
   }
   return false;
 }
-  
+
+static const EnumSet<LastingEffect>& getEffectsWithTick() {
+  static EnumSet<LastingEffect> ret([](LastingEffect effect) { return LastingEffects::hasTick(effect); });
+  return ret;
+}
+
+bool CreatureAttributes::hasTickingEffects() const {
+  return !timedEffects.isEmpty() || !permanentEffectSet.intersection(getEffectsWithTick()).isEmpty();
+}
+
+EnumSet<LastingEffect> CreatureAttributes::getTickingEffects() const {
+  return timedEffects.sum(permanentEffectSet).intersection(getEffectsWithTick());
+}
+
+EnumSet<LastingEffect> CreatureAttributes::popTimedOutEffects(GlobalTime current) {
+  EnumSet<LastingEffect> ret;
+  auto compare = std::greater<pair<GlobalTime, LastingEffect>>();
+  while (!timeouts.empty() && timeouts.front().first <= current) {
+    auto elem = timeouts.front();
+    std::pop_heap(timeouts.begin(), timeouts.end(), compare);
+    timeouts.pop_back();
+    if (timedEffects.contains(elem.second) && lastingEffects[elem.second] == elem.first)
+      ret.insert(elem.second);
+  }
+  return ret;
+}
+
 void CreatureAttributes::addLastingEffect(LastingEffect effect, GlobalTime endTime) {
-  if (lastingEffects[effect] < endTime)
+  if (lastingEffects[effect] < endTime) {
     lastingEffects[effect] = endTime;
+    if (endTime > GlobalTime(0)) {
+      timedEffects.insert(effect);
+      // Extending an effect every turn leaves stale entries behind, so the heap is rebuilt when they pile up.
+      if (timeouts.size() > 2 * timedEffects.getSize() + 8)
+        updateEffectSets();
+      else {
+        timeouts.push_back(make_pair(endTime, effect));
+        std::push_heap(timeouts.begin(), timeouts.end(), std::greater<pair<GlobalTime, LastingEffect>>());
+      }
+    }
+  }
 }
 
 static bool consumeProb() {
@@ -397,19 +457,22 @@ bool CreatureAttributes::canEquip() const {
 }
 
 bool CreatureAttributes::isAffectedPermanently(LastingEffect effect) const {
-  return permanentEffects[effect] > 0;
+  return permanentEffectSet.contains(effect);
 }
 
 void CreatureAttributes::clearLastingEffect(LastingEffect effect) {
   lastingEffects[effect] = GlobalTime(0);
+  timedEffects.erase(effect);
 }
 
 void CreatureAttributes::addPermanentEffect(LastingEffect effect, int count) {
   permanentEffects[effect] += count;
+  updatePermanentEffect(effect);
 }
 
 void CreatureAttributes::removePermanentEffect(LastingEffect effect, int count) {
   permanentEffects[effect] -= count;
+  updatePermanentEffect(effect);
 }
 
 const MinionActivityMap& CreatureAttributes::getMinionActivities() const {
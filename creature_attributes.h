@@ -104,6 +104,13 @@ class CreatureAttributes {
   void addPermanentEffect(LastingEffect, int count);
   void removePermanentEffect(LastingEffect, int count);
   bool considerTimeout(LastingEffect, GlobalTime current);
+  /** Returns true if any effect needs attention every turn, either because it has a timeout or it ticks.*/
+  bool hasTickingEffects() const;
+  /** Returns the effects with a timeout that has passed, and forgets about them. The caller should clear them with
+      considerTimeout().*/
+  EnumSet<LastingEffect> popTimedOutEffects(GlobalTime current);
+  /** Returns the effects whose LastingEffects::tick() may do something.*/
+  EnumSet<LastingEffect> getTickingEffects() const;
   void addLastingEffect(LastingEffect, GlobalTime endtime);
   optional<GlobalTime> getLastAffected(LastingEffect, GlobalTime currentGlobalTime) const;
   bool canSleep() const;
@@ -149,6 +156,11 @@ class CreatureAttributes {
   vector<SpellId> SERIAL(spells);
   EnumMap<LastingEffect, int> SERIAL(permanentEffects);
   EnumMap<LastingEffect, GlobalTime> SERIAL(lastingEffects);
+  // Derived from the two maps above.
+  EnumSet<LastingEffect> permanentEffectSet;
+  EnumSet<LastingEffect> timedEffects;
+  // Min-heap of timeouts. Entries that don't match lastingEffects anymore are dropped when they reach the top.
+  vector<pair<GlobalTime, LastingEffect>> timeouts;
   MinionActivityMap SERIAL(minionActivities);
   EnumMap<ExperienceType, double> SERIAL(expLevel);
   EnumMap<ExperienceType, int> SERIAL(maxLevelIncrease);
@@ -161,6 +173,8 @@ class CreatureAttributes {
   optional<LastingEffect> SERIAL(hatedByEffect);
   bool SERIAL(instantPrisoner) = false;
   void initializeLastingEffects();
+  void updateEffectSets();
+  void updatePermanentEffect(LastingEffect);
   CreatureInventory SERIAL(inventory);
   pair<int, vector<string>> SERIAL(automatonSlots) = {0, {}};
 };
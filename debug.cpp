@@ -33,19 +33,192 @@ DebugOutput DebugOutput::toString(function<void (const string&)> callback) {
 }
 
 DebugOutput DebugOutput::crash() {
-  return DebugOutput(*(new stringstream()), [] { fail(); });
+  DebugOutput ret(*(new stringstream()), [] { InfoLog.flush(); fail(); });
+  ret.endsProgram = true;
+  return ret;
 }
 
 DebugOutput DebugOutput::exitProgram() {
-  return DebugOutput(*(new stringstream()), [] { exit(0); });
+  DebugOutput ret(*(new stringstream()), [] { exit(0); });
+  ret.endsProgram = true;
+  return ret;
 }
 
 void DebugLog::addOutput(DebugOutput o) {
+  RecursiveLock lock(mutex);
   outputs.push_back(o);
+  hasOutputs = true;
+}
+
+atomic<bool> DebugLog::categories[maxCategories];
+atomic<bool> DebugLog::disabledInChild {false};
+
+void DebugLog::disableInForkedChild() {
+  disabledInChild = true;
+}
+
+namespace {
+struct CategoryRegistry {
+  std::mutex lock;
+  map<string, int> indexes;
+  map<string, bool> enabled;
+  bool defaultEnabled = true;
+
+  bool isEnabled(const string& name) {
+    if (auto value = getValueMaybe(enabled, name))
+      return *value;
+    return defaultEnabled;
+  }
+};
+}
+
+static CategoryRegistry& getCategoryRegistry() {
+  static CategoryRegistry ret;
+  return ret;
+}
+
+int DebugLog::getCategory(const char* file) {
+  string name = file;
+  auto slash = name.find_last_of("/\\");
+  if (slash != string::npos)
+    name = name.substr(slash + 1);
+  name = name.substr(0, name.find('.'));
+  auto& registry = getCategoryRegistry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  if (auto index = getValueMaybe(registry.indexes, name))
+    return *index;
+  // All categories beyond the limit share the last slot.
+  int index = min<int>(registry.indexes.size(), maxCategories - 1);
+  registry.indexes[name] = index;
+  categories[index] = registry.isEnabled(name);
+  return index;
+}
+
+void DebugLog::setCategoryEnabled(const string& name, bool state) {
+  auto& registry = getCategoryRegistry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  registry.enabled[name] = state;
+  if (auto index = getValueMaybe(registry.indexes, name))
+    categories[*index] = state;
+}
+
+void DebugLog::setDefaultCategoryEnabled(bool state) {
+  auto& registry = getCategoryRegistry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  registry.defaultEnabled = state;
+  for (auto& elem : registry.indexes)
+    categories[elem.second] = registry.isEnabled(elem.first);
+}
+
+static std::vector<unique_ptr<std::ostringstream>>& getFreeBuffers() {
+  static thread_local std::vector<unique_ptr<std::ostringstream>> ret;
+  return ret;
+}
+
+DebugLog::Logger::Logger(DebugLog& l) : log(&l) {
+  if (disabledInChild)
+    return;
+  if (log->async) {
+    auto& freeBuffers = getFreeBuffers();
+    if (freeBuffers.empty())
+      freeBuffers.push_back(unique<std::ostringstream>());
+    buffer = freeBuffers.back().release();
+    freeBuffers.pop_back();
+  } else
+    lock = RecursiveLock(log->mutex);
+}
+
+DebugLog::Logger::Logger(Logger&& o) : log(o.log), buffer(o.buffer), lock(std::move(o.lock)) {
+  o.log = nullptr;
+  o.buffer = nullptr;
+}
+
+DebugLog::Logger::~Logger() {
+  if (!log)
+    return;
+  if (buffer) {
+    log->push(buffer->str());
+    buffer->str("");
+    getFreeBuffers().push_back(unique_ptr<std::ostringstream>(buffer));
+  } else if (lock.owns_lock())
+    for (int i = log->outputs.size() - 1; i >= 0; --i)
+      log->outputs[i].onLineEnd();
+  else if (disabledInChild)
+    // The outputs are only added at startup, so they can be read without the lock.
+    for (auto& output : log->outputs)
+      if (output.endsProgram)
+        std::_Exit(1);
 }
 
 DebugLog::Logger DebugLog::get() {
-  return Logger(outputs);
+  return Logger(*this);
+}
+
+void DebugLog::writeLine(const string& line) {
+  RecursiveLock lock(mutex);
+  for (int i = outputs.size() - 1; i >= 0; --i) {
+    outputs[i].out << line;
+    outputs[i].onLineEnd();
+  }
+}
+
+void DebugLog::push(string text) {
+  auto line = new Line();
+  line->text = std::move(text);
+  auto previous = queueHead.exchange(line, std::memory_order_acq_rel);
+  previous->next.store(line, std::memory_order_release);
+  // The writer could have stopped while the line was formatted.
+  if (!async)
+    flush();
+}
+
+bool DebugLog::writePending() {
+  // The lock makes sure that there is only one reader of the queue.
+  RecursiveLock lock(mutex);
+  bool wrote = false;
+  while (auto next = queueTail->next.load(std::memory_order_acquire)) {
+    delete queueTail;
+    queueTail = next;
+    writeLine(next->text);
+    next->text.clear();
+    wrote = true;
+  }
+  return wrote;
+}
+
+void DebugLog::flush() {
+  if (queueTail)
+    writePending();
+}
+
+void DebugLog::startWriterThread() {
+  if (writer)
+    return;
+  if (!queueTail) {
+    queueTail = new Line();
+    queueHead = queueTail;
+  }
+  writerRunning = true;
+  async = true;
+  writer = unique<thread>([this] {
+    while (writerRunning)
+      if (!writePending())
+        sleep_for(milliseconds(10));
+  });
+}
+
+void DebugLog::stopWriterThread() {
+  if (!writer)
+    return;
+  async = false;
+  writerRunning = false;
+  writer->join();
+  writer.reset();
+  flush();
+}
+
+DebugLog::~DebugLog() {
+  stopWriterThread();
 }
 
 DebugLog InfoLog;
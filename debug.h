@@ -21,7 +21,16 @@
 #define FATAL FatalLog.get() << "FATAL " << __FILE__ << ":" << __LINE__ << " "
 #define USER_FATAL UserErrorLog.get()
 #define USER_INFO UserInfoLog.get()
-#define INFO InfoLog.get() << __FILE__ << ":" <<  __LINE__ << " "
+// The arguments of INFO are only evaluated if the line will be written somewhere. Building with NO_INFO_LOG
+// removes all INFO lines from the program.
+// The macro is a single expression, so it can't capture an else that follows it.
+#ifdef NO_INFO_LOG
+#define INFO true ? (void) 0 : LogVoidify() & InfoLog.get()
+#else
+#define INFO !InfoLog.isEnabled(LOG_CATEGORY) ? (void) 0 :\
+    LogVoidify() & InfoLog.get() << __FILE__ << ":" <<  __LINE__ << " "
+#endif
+#define LOG_CATEGORY ([] { static const int category = DebugLog::getCategory(__FILE__); return category; }())
 #define CHECK(exp) if (!(exp)) FATAL << ": " << #exp << " is false. "
 #define USER_CHECK(exp) if (!(exp)) USER_FATAL
 //#define CHECKEQ(exp, exp2) if ((exp) != (exp2)) FATAL << __FILE__ << ":" << __LINE__ << ": " << #exp << " = " << #exp2 << " is false. " << exp << " " << exp2
@@ -67,6 +76,7 @@ class DebugOutput {
   typedef function<void()> LineEndFun;
   std::ostream& out;
   LineEndFun onLineEnd;
+  bool endsProgram = false;
 
   private:
   DebugOutput(std::ostream& o, LineEndFun end) : out(o), onLineEnd(end) {}
@@ -76,29 +86,84 @@ class DebugLog {
   public:
   void addOutput(DebugOutput);
 
+  /** Returns false if a line in the given category would not be written anywhere.*/
+  bool isEnabled(int category) const {
+    return hasOutputs.load(std::memory_order_relaxed) && categories[category].load(std::memory_order_relaxed) &&
+        !disabledInChild.load(std::memory_order_relaxed);
+  }
+
+  /** Categories are the source files that log lines come from, e.g. "creature" for creature.cpp.*/
+  static int getCategory(const char* file);
+  static void setCategoryEnabled(const string& name, bool);
+  /** Sets the state of all categories that weren't set by name.*/
+  static void setDefaultCategoryEnabled(bool);
+
+  /** Turns off all logs in a forked child process, where other threads of the parent might have held their locks.
+      Only lock-free state is touched from then on, and lines that would end the program end it with _Exit(1).*/
+  static void disableInForkedChild();
+
+  /** Makes a thread write the lines to the outputs, so logging never waits for them.*/
+  void startWriterThread();
+  /** Writes all pending lines and goes back to writing on the logging thread.*/
+  void stopWriterThread();
+  /** Writes all pending lines on this thread.*/
+  void flush();
+
   class Logger {
     public:
-    Logger(std::vector<DebugOutput>& s) : outputs(s) {}
+    Logger(DebugLog&);
+    Logger(Logger&&);
 
     template <typename T>
     Logger& operator << (const T& t) {
-      for (int i = outputs.size() - 1; i >= 0; --i)
-        outputs[i].out << t;
+      if (buffer)
+        *buffer << t;
+      else if (lock.owns_lock())
+        for (int i = log->outputs.size() - 1; i >= 0; --i)
+          log->outputs[i].out << t;
       return *this;
     }
-    ~Logger() {
-      for (int i = outputs.size() - 1; i >= 0; --i)
-        outputs[i].onLineEnd();
-    }
+    ~Logger();
 
     private:
-    std::vector<DebugOutput>& outputs;
+    DebugLog* log;
+    // Lines are first formatted here if they are written by the writer thread.
+    std::ostringstream* buffer = nullptr;
+    // Keeps lines written from different threads apart.
+    RecursiveLock lock;
   };
 
   Logger get();
 
+  ~DebugLog();
+
   private:
+  void writeLine(const string&);
+  void push(string line);
+  bool writePending();
   std::vector<DebugOutput> outputs;
+  recursive_mutex mutex;
+  atomic<bool> hasOutputs {false};
+  static constexpr int maxCategories = 512;
+  static atomic<bool> categories[maxCategories];
+  static atomic<bool> disabledInChild;
+
+  // Lock-free queue of lines waiting for the writer thread. Loggers add lines at the head, the writer
+  // takes them from the tail.
+  struct Line {
+    atomic<Line*> next {nullptr};
+    string text;
+  };
+  atomic<Line*> queueHead {nullptr};
+  Line* queueTail = nullptr;
+  atomic<bool> async {false};
+  atomic<bool> writerRunning {false};
+  unique_ptr<thread> writer;
+};
+
+// Turns a logged line into void, so both branches of the INFO expression have the same type.
+struct LogVoidify {
+  void operator & (const DebugLog::Logger&) {}
 };
 
 extern DebugLog InfoLog;
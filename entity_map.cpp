@@ -193,6 +193,7 @@ SERIALIZABLE_TMPL(EntityMap, Creature, ExperienceType);
 SERIALIZABLE_TMPL(EntityMap, Creature, ZoneId);
 SERIALIZABLE_TMPL(EntityMap, Creature, EnumSet<EquipmentSlot>);
 SERIALIZABLE_TMPL(EntityMap, Creature, LocalTime);
+SERIALIZABLE_TMPL(EntityMap, Collective, GlobalTime);
 SERIALIZABLE_TMPL(EntityMap, Task, LocalTime);
 SERIALIZABLE_TMPL(EntityMap, Task, MinionActivity);
 SERIALIZABLE_TMPL(EntityMap, Task, WTask);
@@ -309,7 +309,7 @@ namespace cereal
         auto id = itsSharedPointerMap.find( addr );
         if( id == itsSharedPointerMap.end() )
         {
-          auto ptrId = itsCurrentPointerId++;
+          auto ptrId = itsStablePointerIds ? getStablePointerId( addr ) : itsCurrentPointerId++;
           itsSharedPointerMap.insert( {addr, ptrId} );
           return ptrId | detail::msb_32bit; // mask MSB to be 1
         }
@@ -317,6 +317,15 @@ namespace cereal
           return id->second;
       }
 
+      //! Derives the ids of shared pointers from their addresses instead of the order of saving
+      /*! Saving the same objects twice then produces the same bytes for them, even if other objects
+          were added or removed in between. Loading doesn't depend on the order of the ids.
+          (KeeperRL addition) */
+      void setStablePointerIds( bool stable )
+      {
+        itsStablePointerIds = stable;
+      }
+
       //! Registers a polymorphic type name with the archive
       /*! This function is used to track polymorphic types to prevent
           unnecessary saves of identifying strings used by the polymorphic
@@ -556,6 +565,19 @@ namespace cereal
 
     #undef PROCESS_IF
 
+      //! Hashes the address into a free 31 bit id, the top bit is reserved for marking new pointers
+      std::uint32_t getStablePointerId( void const * addr )
+      {
+        std::uint64_t hash = reinterpret_cast<std::uintptr_t>( addr );
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+        hash ^= hash >> 31;
+        std::uint32_t ptrId = static_cast<std::uint32_t>( hash ) & ~detail::msb_32bit;
+        while( ptrId == 0 || !itsUsedPointerIds.insert( ptrId ).second )
+          ptrId = (ptrId + 1) & ~detail::msb_32bit;
+        return ptrId;
+      }
+
     private:
       ArchiveType * const self;
 
@@ -568,6 +590,12 @@ namespace cereal
       //! The id to be given to the next pointer
       std::uint32_t itsCurrentPointerId;
 
+      //! Whether pointer ids are derived from addresses, see setStablePointerIds
+      bool itsStablePointerIds = false;
+
+      //! The ids given out if they are derived from addresses
+      std::unordered_set<std::uint32_t> itsUsedPointerIds;
+
       //! Maps from polymorphic type name strings to ids
       std::unordered_map<char const *, std::uint32_t> itsPolymorphicTypeMap;
 
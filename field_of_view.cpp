@@ -20,12 +20,16 @@
 #include "square_array.h"
 #include "level.h"
 #include "position.h"
+#include "subsystem_timer.h"
 
 template <class Archive>
 void FieldOfView::serialize(Archive& ar, const unsigned int) {
   ar(level, vision, blocking);
-  if (Archive::is_loading::value)
+  if (Archive::is_loading::value) {
     visibility = Table<unique_ptr<Visibility>>(level->getBounds());
+    blockingBits = unique<BlockingBits>(blocking);
+    updateMemoryCounter();
+  }
 }
 
 #ifdef MEM_USAGE_TEST
@@ -42,7 +46,7 @@ SERIALIZATION_CONSTRUCTOR_IMPL(FieldOfView)
 
 template <typename Archive>
 void FieldOfView::Visibility::serialize(Archive& ar, const unsigned int) {
-  ar(visibleTiles);
+  ar(visible);
 }
 
 SERIALIZABLE(FieldOfView::Visibility)
@@ -53,72 +57,276 @@ FieldOfView::FieldOfView(WLevel l, VisionId v)
     : level(l), visibility(l->getBounds()), vision(v), blocking(l->getBounds().minusMargin(-1), true) {
   for (auto v : blocking.getBounds())
     blocking[v] = !Position(v, level).canSeeThru(vision);
+  blockingBits = unique<BlockingBits>(blocking);
+  updateMemoryCounter();
+}
+
+static size_t cacheBudget = 4 * 1024 * 1024;
+
+void FieldOfView::setCacheBudget(size_t bytes) {
+  cacheBudget = bytes;
+}
+
+size_t FieldOfView::getEntrySize() {
+  return sizeof(Visibility);
+}
+
+void FieldOfView::updateMemoryCounter() {
+  // The blocking bits keep two copies of the blocking map, at one bit per tile.
+  memoryCounter.set(stats.memoryUsage + visibility.getBounds().area() * sizeof(unique_ptr<Visibility>) +
+      blocking.getBounds().area() * (sizeof(bool) + 2.0 / 8));
+}
+
+const VisibilityCacheStats& FieldOfView::getCacheStats() const {
+  return stats;
+}
+
+void FieldOfView::unlink(Visibility* elem) {
+  (elem->newer ? elem->newer->older : newest) = elem->older;
+  (elem->older ? elem->older->newer : oldest) = elem->newer;
+  elem->newer = elem->older = nullptr;
+}
+
+void FieldOfView::pushNewest(Visibility* elem) {
+  elem->older = newest;
+  if (newest)
+    newest->newer = elem;
+  newest = elem;
+  if (!oldest)
+    oldest = elem;
+}
+
+FieldOfView::Visibility& FieldOfView::getVisibility(Vec2 pos) {
+  if (auto& elem = visibility[pos]) {
+    ++stats.hits;
+    if (elem.get() != newest) {
+      unlink(elem.get());
+      pushNewest(elem.get());
+    }
+    return *elem;
+  }
+  ++stats.misses;
+  SubsystemTimer timer(Subsystem::FIELD_OF_VIEW);
+  size_t maxEntries = max<size_t>(1, cacheBudget / getEntrySize());
+  while (stats.numEntries >= maxEntries) {
+    eraseVisibility(oldest->position);
+    ++stats.evictions;
+  }
+  auto& elem = visibility[pos];
+  elem = unique<Visibility>(level->getBounds(), *blockingBits, pos.x, pos.y);
+  elem->position = pos;
+  pushNewest(elem.get());
+  ++stats.numEntries;
+  stats.memoryUsage = stats.numEntries * getEntrySize();
+  updateMemoryCounter();
+  return *elem;
+}
+
+void FieldOfView::eraseVisibility(Vec2 pos) {
+  if (auto& elem = visibility[pos]) {
+    unlink(elem.get());
+    elem.reset();
+    --stats.numEntries;
+    stats.memoryUsage = stats.numEntries * getEntrySize();
+    updateMemoryCounter();
+  }
 }
 
 bool FieldOfView::canSee(Vec2 from, Vec2 to) {
   PROFILE;;
   if ((from - to).lengthD() > sightRange)
     return false;
-  if (!visibility[from])
-    visibility[from].reset(new Visibility(level->getBounds(), blocking, from.x, from.y));
-  return visibility[from]->checkVisible(to.x - from.x, to.y - from.y);
+  return getVisibility(from).checkVisible(to.x - from.x, to.y - from.y);
 }
 
 void FieldOfView::squareChanged(Vec2 pos) {
   PROFILE;
   blocking[pos] = !Position(pos, level).canSeeThru(vision);
-  vector<Vec2> updateList;
-  if (!visibility[pos])
-    visibility[pos].reset(new Visibility(level->getBounds(), blocking, pos.x, pos.y));
+  blockingBits->set(pos, blocking[pos]);
   for (Vec2 v : Rectangle::centered(pos, sightRange))
-    if (v.inRectangle(visibility.getBounds()) && visibility[v] && visibility[v]->checkVisible(pos.x - v.x, pos.y - v.y)) {
-      visibility[v].reset();
-    }
+    if (v.inRectangle(visibility.getBounds()) && visibility[v] && visibility[v]->checkVisible(pos.x - v.x, pos.y - v.y))
+      eraseVisibility(v);
 }
 
-void FieldOfView::Visibility::setVisible(Rectangle bounds, int x, int y) {
-  if (Vec2(px + x, py + y).inRectangle(bounds) &&
-      !visible[x + sightRange][y + sightRange] && x * x + y * y <= sightRange * sightRange) {
-    visible[x + sightRange][y + sightRange] = 1;
-    visibleTiles.push_back(SVec2{short(px + x), short(py + y)});
-  }
+// Lines are padded with a blocking word on each side, so that reads starting up to 64 tiles outside the map
+// don't need special cases.
+static const int lineMargin = 64;
+
+FieldOfView::BlockingBits::BlockingBits(const Table<bool>& blocking) : bounds(blocking.getBounds()),
+    rowWords((bounds.width() + 2 * lineMargin + 63) / 64 + 1),
+    columnWords((bounds.height() + 2 * lineMargin + 63) / 64 + 1),
+    rows(rowWords * bounds.height(), ~uint64_t(0)), columns(columnWords * bounds.width(), ~uint64_t(0)) {
+  for (Vec2 v : bounds)
+    set(v, blocking[v]);
+}
+
+void FieldOfView::BlockingBits::set(Vec2 pos, bool value) {
+  Vec2 v = pos - bounds.topLeft();
+  auto update = [value] (uint64_t& word, int bit) {
+    if (value)
+      word |= uint64_t(1) << bit;
+    else
+      word &= ~(uint64_t(1) << bit);
+  };
+  int x = v.x + lineMargin;
+  update(rows[v.y * rowWords + x / 64], x % 64);
+  int y = v.y + lineMargin;
+  update(columns[v.x * columnWords + y / 64], y % 64);
 }
 
-FieldOfView::Visibility::Visibility(Rectangle bounds, const Table<bool>& blocking, int x, int y) : px(x), py(y) {
+uint64_t FieldOfView::BlockingBits::get(const vector<uint64_t>& words, int lineWords, int line, int numLines,
+    int offset) {
+  offset += lineMargin;
+  if (line < 0 || line >= numLines || offset < 0 || offset / 64 + 1 >= lineWords)
+    return ~uint64_t(0);
+  auto word = &words[line * lineWords + offset / 64];
+  int shift = offset % 64;
+  if (shift == 0)
+    return word[0];
+  return (word[0] >> shift) | (word[1] << (64 - shift));
+}
+
+uint64_t FieldOfView::BlockingBits::getRow(int x, int y) const {
+  return get(rows, rowWords, y - bounds.top(), bounds.height(), x - bounds.left());
+}
+
+uint64_t FieldOfView::BlockingBits::getColumn(int x, int y) const {
+  return get(columns, columnWords, x - bounds.left(), bounds.width(), y - bounds.top());
+}
+
+static const int octantWidth = 2 * FieldOfView::sightRange + 1;
+
+static uint64_t getRangeMask(int from, int to) {
+  return (~uint64_t(0) >> (63 - (to - from))) << from;
+}
+
+// Mirrors an octant row, so that bit i + sightRange becomes bit sightRange - i.
+static uint64_t reverseRow(uint64_t row) {
+  row = ((row >> 1) & 0x5555555555555555ull) | ((row & 0x5555555555555555ull) << 1);
+  row = ((row >> 2) & 0x3333333333333333ull) | ((row & 0x3333333333333333ull) << 2);
+  row = ((row >> 4) & 0x0f0f0f0f0f0f0f0full) | ((row & 0x0f0f0f0f0f0f0f0full) << 4);
+  return __builtin_bswap64(row) >> (64 - octantWidth);
+}
+
+static int getLowestBit(uint64_t word) {
+  return __builtin_ctzll(word);
+}
+
+FieldOfView::Visibility::Visibility(Rectangle bounds, const BlockingBits& blocking, int x, int y) {
   PROFILE;
-  calculate(2 * sightRange, 2 * sightRange,2 * sightRange, 2,-1,1,1,1,
-      [&](int px, int py) { return blocking[Vec2(x + px, y + py)]; },
-      [&](int px, int py) { setVisible(bounds, px, py); });
-  calculate(2 * sightRange, 2 * sightRange,2 * sightRange, 2,-1,1,1,1,
-      [&](int px, int py) { return blocking[Vec2(x + py, y - px)]; },
-      [&](int px, int py) { setVisible(bounds, py, -px); });
-  calculate(2 * sightRange, 2 * sightRange,2 * sightRange,2,-1,1,1,1,
-      [&](int px, int py) { return blocking[Vec2(x - px, y - py)]; },
-      [&](int px, int py) { setVisible(bounds, -px, -py); });
-  calculate(2 * sightRange, 2 * sightRange,2 * sightRange,2,-1,1,1,1,
-      [&](int px, int py) { return blocking[Vec2(x - py, y + px)]; },
-      [&](int px, int py) { setVisible(bounds, -py, px); });
-  setVisible(bounds, 0, 0);
-  visibleTiles.shrink_to_fit();
-/*  ++numSamples;
-  totalIter += visibleTiles.size();
-  if (numSamples%100 == 0)
-    INFO << numSamples << " iterations " << totalIter / numSamples << " avg";*/
+  // The four octant pairs, each scanning rows going away from the viewer. Rows of the first pair
+  // are rows of the map, the others are mirrored rows or columns.
+  array<OctantRows, 4> blockingRows;
+  for (int r : Range(sightRange + 1)) {
+    blockingRows[0][r] = blocking.getRow(x - sightRange, y + r);
+    blockingRows[1][r] = reverseRow(blocking.getColumn(x + r, y - sightRange));
+    blockingRows[2][r] = reverseRow(blocking.getRow(x - sightRange, y - r));
+    blockingRows[3][r] = blocking.getColumn(x - r, y - sightRange);
+  }
+  array<OctantRows, 4> visibleRows {};
+  for (int i : Range(4))
+    calculate(blockingRows[i], visibleRows[i], 2, -1, 1, 1, 1);
+  for (auto& row : visible)
+    row = 0;
+  for (int r : Range(sightRange + 1)) {
+    visible[sightRange + r] |= visibleRows[0][r];
+    visible[sightRange - r] |= reverseRow(visibleRows[2][r]);
+    for (uint64_t bits = visibleRows[1][r]; bits; bits &= bits - 1)
+      visible[octantWidth - 1 - getLowestBit(bits)] |= uint64_t(1) << (sightRange + r);
+    for (uint64_t bits = visibleRows[3][r]; bits; bits &= bits - 1)
+      visible[getLowestBit(bits)] |= uint64_t(1) << (sightRange - r);
+  }
+  visible[sightRange] |= uint64_t(1) << sightRange;
+  for (int dy : Range(-sightRange, sightRange + 1)) {
+    auto& row = visible[dy + sightRange];
+    if (y + dy < bounds.top() || y + dy >= bounds.bottom()) {
+      row = 0;
+      continue;
+    }
+    int halfWidth = 0;
+    while (halfWidth < sightRange && (halfWidth + 1) * (halfWidth + 1) + dy * dy <= sightRange * sightRange)
+      ++halfWidth;
+    int from = max(-halfWidth, bounds.left() - x);
+    int to = min(halfWidth, bounds.right() - 1 - x);
+    row = from > to ? 0 : row & getRangeMask(from + sightRange, to + sightRange);
+  }
 }
 
-const vector<SVec2>& FieldOfView::Visibility::getVisibleTiles() const {
-  return visibleTiles;
+void FieldOfView::Visibility::getVisibleTiles(Vec2 from, int radius, vector<SVec2>& ret) const {
+  ret.clear();
+  radius = min(radius, sightRange);
+  auto mask = getRangeMask(sightRange - radius, sightRange + radius);
+  for (int dy : Range(-radius, radius + 1))
+    for (uint64_t bits = visible[dy + sightRange] & mask; bits; bits &= bits - 1)
+      ret.push_back(SVec2{short(from.x + getLowestBit(bits) - sightRange), short(from.y + dy)});
 }
 
-const vector<SVec2>& FieldOfView::getVisibleTiles(Vec2 from) {
-  if (!visibility[from]) {
-    visibility[from].reset(new Visibility(level->getBounds(), blocking, from.x, from.y));
+vector<SVec2> FieldOfView::getVisibleTiles(Vec2 from, int radius) {
+  vector<SVec2> ret;
+  getVisibility(from).getVisibleTiles(from, radius, ret);
+  return ret;
+}
+
+void FieldOfView::Visibility::calculate(const OctantRows& blocking, OctantRows& visible, int h, int x1, int y1,
+    int x2, int y2) {
+  const int left = 2 * sightRange;
+  const int right = 2 * sightRange;
+  const int up = 2 * sightRange;
+  if (y2*x1>=y1*x2) return;
+  if (h>up) return;
+  int leftx=x1, lefty=y1, rightx=x2, righty=y2;
+  int left_v=(int)floor((double)x1/y1*(h)),
+      right_v=(int)ceil((double)x2/y2*(h)),
+      left_b=(int)floor((double)x1/y1*(h-1)),
+      right_b=(int)ceil((double)x2/y2*(h+1));
+  if (left_v % 2)
+    ++left_v;
+  if (right_v % 2)
+    --right_v;
+  if(left_b % 2)
+    ++left_b;
+  if(right_b % 2)
+    --right_b;
+  auto& row = blocking[h / 2];
+  if(left_b>=-left && left_b<=right && ((row >> (left_b / 2 + sightRange)) & 1)){
+    leftx=left_b+1;
+    lefty=h+(left_b>=0?-1:1);
   }
-  return visibility[from]->getVisibleTiles();
+  if(left_v<-left) left_v=-left;
+  if(right_v>right) right_v=right;
+  int from = left_v / 2;
+  int to = right_v / 2;
+  if (from <= to) {
+    auto mask = getRangeMask(from + sightRange, to + sightRange);
+    visible[h / 2] |= mask;
+    // Each run of blocking tiles splits off the part of the view to its left, and moves the left edge past it.
+    for (uint64_t bits = row & mask; bits;) {
+      int runStart = getLowestBit(bits);
+      int runEnd = runStart + getLowestBit(~(bits >> runStart)) - 1;
+      bits &= ~getRangeMask(0, runEnd);
+      runStart -= sightRange;
+      runEnd -= sightRange;
+      if (runStart > from)
+        calculate(blocking, visible, h + 2, leftx, lefty, runStart * 2 - 1, h + (runStart<=0 ? -1:1));
+      leftx=runEnd*2+1;
+      lefty=h+(runEnd>=0?-1:1);
+    }
+  }
+  calculate(blocking, visible, h + 2, leftx, lefty, rightx, righty);
 }
 
+bool FieldOfView::Visibility::checkVisible(int x, int y) const {
+  return x >= -sightRange && y >= -sightRange && x <= sightRange && y <= sightRange &&
+    ((visible[sightRange + y] >> (sightRange + x)) & 1);
+}
 
-void FieldOfView::Visibility::calculate(int left, int right, int up, int h, int x1, int y1, int x2, int y2,
+vector<Vec2> FieldOfView::computeVisibleTiles(Rectangle bounds, const Table<bool>& blocking, Vec2 from) {
+  vector<SVec2> ret;
+  Visibility(bounds, BlockingBits(blocking), from.x, from.y).getVisibleTiles(from, sightRange, ret);
+  return ret.transform([](SVec2 v) { return Vec2(v.x, v.y); });
+}
+
+static void calculateReference(int left, int right, int up, int h, int x1, int y1, int x2, int y2,
     function<bool (int, int)> isBlocking, function<void (int, int)> setVisible){
   if (y2*x1>=y1*x2) return;
   if (h>up) return;
@@ -147,19 +355,37 @@ void FieldOfView::Visibility::calculate(int left, int right, int up, int h, int
     setVisible(i, h / 2);
     bool blocking = isBlocking(i, h / 2);
     if(i > left_v / 2 && blocking && !prevBlocking)
-      calculate(left, right, up, h + 2, leftx, lefty, i * 2 - 1, h + (i<=0 ? -1:1), isBlocking, setVisible);
+      calculateReference(left, right, up, h + 2, leftx, lefty, i * 2 - 1, h + (i<=0 ? -1:1), isBlocking, setVisible);
     if(blocking){
       leftx=i*2+1;
       lefty=h+(i>=0?-1:1);
     }
     prevBlocking = blocking;
   }
-  calculate(left, right, up, h + 2, leftx, lefty, rightx, righty, isBlocking, setVisible);
+  calculateReference(left, right, up, h + 2, leftx, lefty, rightx, righty, isBlocking, setVisible);
 }
 
-bool FieldOfView::Visibility::checkVisible(int x, int y) const {
-  return x >= -sightRange && y >= -sightRange && x <= sightRange && y <= sightRange &&
-    visible[sightRange + x][sightRange + y] == 1;
+vector<Vec2> FieldOfView::computeVisibleTilesReference(Rectangle bounds, const Table<bool>& blocking, Vec2 from) {
+  const int range = sightRange;
+  set<Vec2> visible;
+  auto setVisible = [&](int x, int y) {
+    if ((from + Vec2(x, y)).inRectangle(bounds) && x * x + y * y <= range * range)
+      visible.insert(from + Vec2(x, y));
+  };
+  int x = from.x;
+  int y = from.y;
+  calculateReference(2 * range, 2 * range, 2 * range, 2, -1, 1, 1, 1,
+      [&](int px, int py) { return blocking[Vec2(x + px, y + py)]; },
+      [&](int px, int py) { setVisible(px, py); });
+  calculateReference(2 * range, 2 * range, 2 * range, 2, -1, 1, 1, 1,
+      [&](int px, int py) { return blocking[Vec2(x + py, y - px)]; },
+      [&](int px, int py) { setVisible(py, -px); });
+  calculateReference(2 * range, 2 * range, 2 * range, 2, -1, 1, 1, 1,
+      [&](int px, int py) { return blocking[Vec2(x - px, y - py)]; },
+      [&](int px, int py) { setVisible(-px, -py); });
+  calculateReference(2 * range, 2 * range, 2 * range, 2, -1, 1, 1, 1,
+      [&](int px, int py) { return blocking[Vec2(x - py, y + px)]; },
+      [&](int px, int py) { setVisible(-py, px); });
+  setVisible(0, 0);
+  return vector<Vec2>(visible.begin(), visible.end());
 }
-
-
@@ -16,49 +16,100 @@
 #pragma once
 
 #include "util.h"
+#include "memory_telemetry.h"
 
 class Square;
 class SquareArray;
 
+struct VisibilityCacheStats {
+  int hits = 0;
+  int misses = 0;
+  int evictions = 0;
+  int numEntries = 0;
+  size_t memoryUsage = 0;
+};
+
 class FieldOfView {
   public:
   FieldOfView(WLevel, VisionId);
   bool canSee(Vec2 from, Vec2 to);
-  const vector<SVec2>& getVisibleTiles(Vec2 from);
+  /** With a radius, only returns tiles within that distance along each axis.*/
+  vector<SVec2> getVisibleTiles(Vec2 from, int radius = sightRange);
   void squareChanged(Vec2 pos);
+  const VisibilityCacheStats& getCacheStats() const;
+
+  /** Sets how many bytes of visibility data each FieldOfView may keep before evicting the least recently
+      used entries.*/
+  static void setCacheBudget(size_t bytes);
 
   SERIALIZATION_DECL(FieldOfView)
 
   static constexpr int sightRange = 30;
 
+  /** Runs the bit-packed kernel on the given blocking map. Blocking must cover bounds plus a margin of one.*/
+  static vector<Vec2> computeVisibleTiles(Rectangle bounds, const Table<bool>& blocking, Vec2 from);
+  /** Runs the original recursive shadowcasting, which the kernel must agree with.*/
+  static vector<Vec2> computeVisibleTilesReference(Rectangle bounds, const Table<bool>& blocking, Vec2 from);
+
   private:
 
+  /** Copy of the blocking map packed 64 tiles per word, both along rows and along columns, so that
+      a whole octant row of the field of view can be fetched with a couple of word operations.*/
+  class BlockingBits {
+    public:
+    BlockingBits(const Table<bool>&);
+    void set(Vec2, bool);
+    /** Returns the 64 tiles starting at (x, y) going right. Tiles outside the map are blocking.*/
+    uint64_t getRow(int x, int y) const;
+    /** Returns the 64 tiles starting at (x, y) going down. Tiles outside the map are blocking.*/
+    uint64_t getColumn(int x, int y) const;
+
+    private:
+    static uint64_t get(const vector<uint64_t>& words, int lineWords, int line, int numLines, int offset);
+    Rectangle bounds;
+    int rowWords;
+    int columnWords;
+    vector<uint64_t> rows;
+    vector<uint64_t> columns;
+  };
 
   class Visibility {
     public:
 
     bool checkVisible(int x,int y) const;
-    const vector<SVec2>& getVisibleTiles() const;
+    void getVisibleTiles(Vec2 from, int radius, vector<SVec2>&) const;
 
-    Visibility(Rectangle bounds, const Table<bool>& blocking, int x, int y);
+    Visibility(Rectangle bounds, const BlockingBits& blocking, int x, int y);
 
     SERIALIZATION_DECL(Visibility)
 
+    // Links of the LRU order, which starts with the most recently used entry.
+    Visibility* newer = nullptr;
+    Visibility* older = nullptr;
+    Vec2 position;
+
     private:
-    array<bitset<sightRange * 2 + 1>, sightRange * 2 + 1> visible;
-    vector<SVec2> SERIAL(visibleTiles);
-    void calculate(int,int,int,int, int, int, int, int,
-        function<bool (int, int)> isBlocking,
-        function<void (int, int)> setVisible);
-    void setVisible(Rectangle bounds, int, int);
-
-    int px;
-    int py;
+    // Bit i + sightRange of row r holds the tile i to the side and r forward from the viewer, within one octant pair.
+    using OctantRows = array<uint64_t, sightRange + 1>;
+    static void calculate(const OctantRows& blocking, OctantRows& visible, int h, int x1, int y1, int x2, int y2);
+    // Bit x + sightRange of element y + sightRange. The tile list is derived from it when needed.
+    array<uint64_t, sightRange * 2 + 1> SERIAL(visible);
   };
 
+  Visibility& getVisibility(Vec2);
+  void eraseVisibility(Vec2);
+  void unlink(Visibility*);
+  void pushNewest(Visibility*);
+  static size_t getEntrySize();
+  void updateMemoryCounter();
+
   WLevel SERIAL(level) = nullptr;
   Table<unique_ptr<Visibility>> visibility;
   VisionId SERIAL(vision);
   Table<bool> SERIAL(blocking);
+  unique_ptr<BlockingBits> blockingBits;
+  Visibility* newest = nullptr;
+  Visibility* oldest = nullptr;
+  VisibilityCacheStats stats;
+  MemoryCounter memoryCounter {MemoryCategory::FIELD_OF_VIEW};
 };
-
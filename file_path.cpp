@@ -23,6 +23,13 @@ time_t FilePath::getModificationTime() const {
   return buf.st_mtime;
 }
 
+long long FilePath::getSize() const {
+  struct stat buf;
+  if (stat(getPath(), &buf) != 0)
+    return -1;
+  return buf.st_size;
+}
+
 bool FilePath::exists() const {
 #ifdef WINDOWS
   struct _stat buf;
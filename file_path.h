@@ -8,6 +8,7 @@ class FilePath {
   const char* getPath() const;
   const char* getFileName() const;
   time_t getModificationTime() const;
+  long long getSize() const;
   bool exists() const;
   bool hasSuffix(const string&) const;
   FilePath changeSuffix(const string& current, const string& newSuf) const;
@@ -0,0 +1,125 @@
+#include "stdafx.h"
+#include "flow_field.h"
+#include "sectors.h"
+
+static const float infinity = 1000000000;
+
+FlowField::FlowField(Rectangle bounds, const vector<Vec2>& targets, const Sectors& sectors, const CostFun& entryCost)
+    : distance(bounds, infinity) {
+  PROFILE;
+  auto& extraConnections = sectors.getExtraConnections();
+  for (Vec2 v : bounds)
+    if (auto other = extraConnections[v])
+      portals[v] = *other;
+  using QueueElem = pair<float, Vec2>;
+  priority_queue<QueueElem, vector<QueueElem>, std::greater<QueueElem>> q;
+  for (Vec2 v : targets)
+    if (v.inRectangle(bounds)) {
+      distance[v] = 0;
+      q.push(make_pair(0.0f, v));
+    }
+  auto relax = [&](Vec2 next, float posDist) {
+    if (next.inRectangle(bounds) && sectors.contains(next) && posDist < distance[next]) {
+      float dist = posDist + entryCost(next);
+      if (dist < distance[next]) {
+        distance[next] = dist;
+        q.push(make_pair(dist, next));
+      }
+    }
+  };
+  while (!q.empty()) {
+    auto elem = q.top();
+    q.pop();
+    if (elem.first > distance[elem.second])
+      continue;
+    for (Vec2 dir : Vec2::directions8())
+      relax(elem.second + dir, elem.first);
+    if (auto other = getValueMaybe(portals, elem.second))
+      relax(*other, elem.first);
+  }
+}
+
+double FlowField::getDistance(Vec2 v) const {
+  return distance[v];
+}
+
+optional<Vec2> FlowField::getNextMove(Vec2 pos) const {
+  optional<Vec2> ret;
+  float lowest = distance[pos];
+  auto consider = [&](Vec2 next) {
+    if (next.inRectangle(distance.getBounds()) && distance[next] < lowest) {
+      lowest = distance[next];
+      ret = next;
+    }
+  };
+  for (Vec2 dir : Vec2::directions8())
+    consider(pos + dir);
+  if (auto other = getValueMaybe(portals, pos))
+    consider(*other);
+  return ret;
+}
+
+vector<Vec2> FlowField::getPath(Vec2 from) const {
+  if (distance[from] >= infinity)
+    return {};
+  vector<Vec2> ret {from};
+  while (distance[ret.back()] > 0)
+    if (auto next = getNextMove(ret.back()))
+      ret.push_back(*next);
+    else
+      return {};
+  return ret;
+}
+
+bool FlowFieldCache::Key::operator == (const Key& o) const {
+  return targets == o.targets && movement == o.movement;
+}
+
+// A field is worth its cost once several creatures head to the same place.
+static const int minRequests = 3;
+static const int maxFields = 8;
+static const int maxEntries = 500;
+
+const FlowField* FlowFieldCache::get(const vector<Vec2>& targets, const MovementType& movement,
+    function<FlowField()> create) {
+  if (entries.size() >= maxEntries) {
+    for (auto it = entries.begin(); it != entries.end();)
+      if (!it->second.field)
+        it = entries.erase(it);
+      else
+        ++it;
+  }
+  auto& entry = entries[Key{targets, movement}];
+  entry.lastUsed = ++useCounter;
+  if (!entry.field && ++entry.numRequests >= minRequests) {
+    if (numFields >= maxFields) {
+      Entry* leastUsed = nullptr;
+      for (auto& elem : entries)
+        if (elem.second.field && (!leastUsed || elem.second.lastUsed < leastUsed->lastUsed))
+          leastUsed = &elem.second;
+      removeField(*leastUsed);
+      leastUsed->numRequests = 0;
+    }
+    entry.field = unique<FlowField>(create());
+    ++numFields;
+  }
+  return entry.field.get();
+}
+
+void FlowFieldCache::removeField(Entry& entry) {
+  if (entry.field) {
+    entry.field.reset();
+    --numFields;
+  }
+}
+
+void FlowFieldCache::clear() {
+  for (auto& elem : entries)
+    removeField(elem.second);
+}
+
+void FlowFieldCache::clear(const MovementType& movement) {
+  for (auto& elem : entries)
+    if (elem.first.movement == movement)
+      removeField(elem.second);
+}
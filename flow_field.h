@@ -0,0 +1,51 @@
+#pragma once
+
+#include "util.h"
+#include "movement_type.h"
+
+class Sectors;
+
+/** Distances from every tile of a level to the nearest of a set of targets. Computed once with a reverse
+    Dijkstra search and then shared by all creatures heading to the same place.*/
+class FlowField {
+  public:
+  using CostFun = function<double(Vec2)>;
+  FlowField(Rectangle bounds, const vector<Vec2>& targets, const Sectors&, const CostFun& entryCost);
+
+  /** Returns the path from the given tile to the nearest target, including both ends.
+      Returns an empty vector if no target can be reached.*/
+  vector<Vec2> getPath(Vec2 from) const;
+  optional<Vec2> getNextMove(Vec2) const;
+  double getDistance(Vec2) const;
+
+  private:
+  Table<float> distance;
+  unordered_map<Vec2, Vec2, CustomHash<Vec2>> portals;
+};
+
+/** Keeps the flow fields of a level. A field is only computed after its query was repeated a few times,
+    so one-off destinations still use a regular search. The fields of a movement type are dropped when its
+    connectivity or costs change, but their request counts are kept, so they are rebuilt on the next request.*/
+class FlowFieldCache {
+  public:
+  const FlowField* get(const vector<Vec2>& targets, const MovementType&, function<FlowField()> create);
+  void clear();
+  void clear(const MovementType&);
+
+  private:
+  struct Key {
+    vector<Vec2> targets;
+    MovementType movement;
+    HASH_ALL(targets, movement)
+    bool operator == (const Key&) const;
+  };
+  struct Entry {
+    int numRequests = 0;
+    int lastUsed = 0;
+    unique_ptr<FlowField> field;
+  };
+  void removeField(Entry&);
+  unordered_map<Key, Entry, CustomHash<Key>> entries;
+  int numFields = 0;
+  int useCounter = 0;
+};
@@ -143,6 +143,7 @@ void Furniture::tryToDestroyBy(Position pos, Creature* c, const DestroyAction& a
       damage = damage * c->getAttributes().getSkills().getValue(*skill);
     info->health -= damage / info->strength;
     updateViewObject();
+    pos.updateNavigationCost();
     pos.setNeedsRenderAndMemoryUpdate(true);
     if (tryDestroyFX)
       pos.getGame()->addEvent(EventInfo::FX{pos, *tryDestroyFX});
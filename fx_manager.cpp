@@ -161,13 +161,20 @@ void FXManager::simulate(ParticleSystem &ps, float timeDelta) {
 
 void FXManager::simulate(float delta) {
   PROFILE;
-  for (auto& inst : systems)
+  size_t bytes = snapshotBytes + systems.capacity() * sizeof(ParticleSystem);
+  for (auto& inst : systems) {
     if (!inst.isDead)
       simulate(inst, delta);
+    for (auto& ss : inst.subSystems)
+      bytes += ss.particles.capacity() * sizeof(Particle);
+  }
+  memoryCounter.set(bytes);
   globalSimTime += delta;
 }
 
 void FXManager::addSnapshot(float animTime, const ParticleSystem& ps) {
+  for (auto& ss : ps.subSystems)
+    snapshotBytes += sizeof(ss) + ss.particles.size() * sizeof(Particle);
   SnapshotKey key(ps.params);
   for (auto& group : snapshotGroups[ps.defId])
     if (group.key == key) {
@@ -6,6 +6,7 @@
 #include "fx_defs.h"
 #include "fx_name.h"
 #include "fx_texture_name.h"
+#include "memory_telemetry.h"
 
 namespace fx {
 
@@ -84,5 +85,7 @@ public:
   double accumFrameTime = 0.0f;
   double oldTime = -1.0;
   double globalSimTime = 0.0;
+  size_t snapshotBytes = 0;
+  MemoryCounter memoryCounter {MemoryCategory::FX};
 };
 }
@@ -48,6 +48,10 @@ void Game::serialize(Archive& ar, const unsigned int version) {
   ar(villainsByType, collectives, lastTick, playerControl, playerCollective, currentTime);
   ar(musicType, statistics, tribes, gameIdentifier, players, contentFactory, sunlightTimeOffset);
   ar(gameDisplayName, models, visited, baseModel, campaign, localTime, turnEvents);
+  if (version >= 1)
+    ar(random);
+  else if (Archive::is_loading::value)
+    random.init(Random.get(1000000000));
   if (Archive::is_loading::value)
     sunlightInfo.update(getGlobalTime() + sunlightTimeOffset);
 }
@@ -65,8 +69,10 @@ Game::Game(Table<PModel>&& m, Vec2 basePos, const CampaignSetup& c, ContentFacto
       contentFactory(std::move(f)) {
   gameIdentifier = c.gameIdentifier;
   gameDisplayName = c.gameDisplayName;
+  random.init(Random.get(1000000000));
   for (Vec2 v : models.getBounds())
     if (WModel m = models[v].get()) {
+      m->getRandom().init(random.getChildSeed(v.x + v.y * models.getWidth()));
       for (Collective* col : m->getCollectives()) {
         auto control = dynamic_cast<VillageControl*>(col->getControl());
         control->updateAggression(c.enemyAggressionLevel);
@@ -311,6 +317,8 @@ optional<ExitInfo> Game::update(double timeDiff) {
   if (auto exitInfo = updateInput())
     return exitInfo;
   considerRealTimeRender();
+  // Everything below changes the game state, so it mustn't share the random stream with the UI.
+  RandomGen::Redirect redirect(random);
   WModel currentModel = getCurrentModel();
   auto currentId = currentModel->getTopLevel()->getUniqueId();
   while (!lastTick || currentTime >= *lastTick + 1) {
@@ -386,10 +394,42 @@ void Game::tick(GlobalTime time) {
   INFO << "Global time " << time;
   for (Collective* col : collectives) {
     if (isVillainActive(col))
-      col->update(col->getModel() == getCurrentModel());
+      updateVillain(col, time);
   }
 }
 
+// Villains in models that the player isn't in are only updated once in this many turns.
+static const int remoteUpdateInterval = 10;
+
+void Game::updateVillain(Collective* col, GlobalTime time) {
+  RandomGen::Redirect redirect(col->getModel()->getRandom());
+  bool isCurrent = col->getModel() == getCurrentModel();
+  // The player's collective keeps recruiting wherever the player is, and conquered collectives are dropped from
+  // the schedule, so both are updated every turn.
+  if (col->getVillainType() == VillainType::PLAYER || col->isConquered()) {
+    lastVillainUpdate.erase(col);
+    col->update(isCurrent);
+    return;
+  }
+  if (!lastVillainUpdate.hasKey(col)) {
+    // Spread the updates of different villains over the interval. Ids can be negative.
+    auto id = col->getUniqueId().getGenericId();
+    int offset = int((id % remoteUpdateInterval + remoteUpdateInterval) % remoteUpdateInterval);
+    lastVillainUpdate.set(col, time - 1_visible * (isCurrent ? 1 : 1 + offset));
+  }
+  int numTurns = (time - lastVillainUpdate.getOrFail(col)).getVisibleInt();
+  if (isCurrent) {
+    // Catch up on the turns that were skipped while the player was away.
+    if (numTurns > 1)
+      col->updateRemote(numTurns - 1);
+    col->update(true);
+  } else if (numTurns >= remoteUpdateInterval)
+    col->updateRemote(numTurns);
+  else
+    return;
+  lastVillainUpdate.set(col, time);
+}
+
 void Game::setExitInfo(ExitInfo info) {
   exitInfo = std::move(info);
 }
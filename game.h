@@ -7,6 +7,7 @@
 #include "position.h"
 #include "exit_info.h"
 #include "game_time.h"
+#include "entity_map.h"
 
 class Options;
 class Highscores;
@@ -105,6 +106,7 @@ class Game : public OwnedObject<Game> {
   private:
   optional<ExitInfo> update();
   void tick(GlobalTime);
+  void updateVillain(Collective*, GlobalTime);
   Vec2 getModelCoords(const WModel) const;
   bool updateModel(WModel, double timeDiff);
   string getPlayerName() const;
@@ -124,6 +126,7 @@ class Game : public OwnedObject<Game> {
   string SERIAL(gameDisplayName);
   map<VillainType, vector<Collective*>> SERIAL(villainsByType);
   vector<Collective*> SERIAL(collectives);
+  EntityMap<Collective, GlobalTime> lastVillainUpdate;
   MusicType SERIAL(musicType);
   unique_ptr<CreatureView> spectator;
   HeapAllocated<Statistics> SERIAL(statistics);
@@ -146,4 +149,7 @@ class Game : public OwnedObject<Game> {
   void increaseTime(double diff);
   void spawnKeeper(AvatarInfo, vector<string> introText);
   HeapAllocated<ContentFactory> SERIAL(contentFactory);
+  RandomGen SERIAL(random);
 };
+
+CEREAL_CLASS_VERSION(Game, 1)
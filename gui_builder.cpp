@@ -46,6 +46,7 @@
 #include "special_trait.h"
 #include "encyclopedia.h"
 #include "item_action.h"
+#include "memory_telemetry.h"
 
 using SDL::SDL_Keysym;
 using SDL::SDL_Keycode;
@@ -551,9 +552,19 @@ SGuiElem GuiBuilder::drawRightBandInfo(GameInfo& info) {
               return "LAT " + toString(fpsCounter.getMaxLatency()) + "ms / " + toString(upsCounter.getMaxLatency()) + "ms";
             case CounterMode::SMOD:
               return "SMOD " + toString(modifiedSquares) + "/" + toString(totalSquares);
+            case CounterMode::MEM: {
+              size_t total = 0;
+              auto largest = MemoryCategory(0);
+              for (auto category : ENUM_ALL(MemoryCategory)) {
+                total += MemoryCounter::getTotal(category);
+                if (MemoryCounter::getTotal(category) > MemoryCounter::getTotal(largest))
+                  largest = category;
+              }
+              return "MEM " + toString(total >> 20) + "MB " + toLower(EnumInfo<MemoryCategory>::getString(largest));
+            }
           }
         }, Color::WHITE),
-        WL(button, [=]() { counterMode = (CounterMode) ( ((int) counterMode + 1) % 3); })), 120);
+        WL(button, [=]() { counterMode = (CounterMode) ( ((int) counterMode + 1) % 4); })), 120);
     main = WL(margin, WL(leftMargin, 10, bottomLine.buildHorizontalList()),
         std::move(main), 18, gui.BOTTOM);
     rightBandInfoCache = WL(margin, std::move(butGui), std::move(main), 55, gui.TOP);
@@ -245,7 +245,7 @@ class GuiBuilder {
   const char* getCurrentGameSpeedName() const;
 
   FpsCounter fpsCounter, upsCounter;
-  enum class CounterMode { FPS, LAT, SMOD };
+  enum class CounterMode { FPS, LAT, SMOD, MEM };
   CounterMode counterMode = CounterMode::FPS;
 
   SGuiElem getButtonLine(CollectiveInfo::Button, int num, CollectiveTab, const optional<TutorialInfo>&);
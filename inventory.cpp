@@ -21,9 +21,20 @@
 #include "resource_id.h"
 
 
-SERIALIZE_DEF(Inventory, items, itemsCache, weight, counts)
+template <class Archive>
+void Inventory::serialize(Archive& ar, const unsigned int) {
+  ar(items, itemsCache, weight, counts);
+  if (Archive::is_loading::value)
+    updateMemoryCounter();
+}
+
+SERIALIZABLE(Inventory);
 SERIALIZATION_CONSTRUCTOR_IMPL(Inventory);
 
+void Inventory::updateMemoryCounter() {
+  memoryCounter.set(size() * sizeof(Item));
+}
+
 void Inventory::addViewId(ViewId id, int count) {
   auto& cur = counts[id];
   if (count > 0 && cur < UINT16_MAX)
@@ -49,6 +60,7 @@ void Inventory::addItem(PItem item) {
   }
   weight += item->getWeight();
   items.insert(std::move(item));
+  updateMemoryCounter();
 }
 
 void Inventory::addItems(vector<PItem> v) {
@@ -69,6 +81,7 @@ PItem Inventory::removeItem(Item* itemRef) {
     if (index < resourceIndexes.size() && resourceIndexes[index])
       resourceIndexes[index]->remove(item.get());
   }
+  updateMemoryCounter();
   return item;
 }
 
@@ -91,6 +104,7 @@ vector<PItem> Inventory::removeAllItems() {
   for (auto& ind : resourceIndexes)
     ind = none;
   weight = 0;
+  memoryCounter.set(0);
   return items.removeAll();
 }
 
@@ -23,6 +23,7 @@
 #include "item_index.h"
 #include "item_counts.h"
 #include "entity_set.h"
+#include "memory_telemetry.h"
 
 class Item;
 class Position;
@@ -67,4 +68,6 @@ class Inventory {
   mutable EnumMap<ItemIndex, optional<ItemVector>> indexes;
   mutable vector<optional<ItemVector>> resourceIndexes;
   void addViewId(ViewId, int count);
+  void updateMemoryCounter();
+  MemoryCounter memoryCounter {MemoryCategory::INVENTORIES};
 };
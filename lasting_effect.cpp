@@ -1017,6 +1017,26 @@ bool LastingEffects::tick(Creature* c, LastingEffect effect) {
   return false;
 }
 
+bool LastingEffects::hasTick(LastingEffect effect) {
+  // Must list every effect that has a case in tick().
+  switch (effect) {
+    case LastingEffect::SPYING:
+    case LastingEffect::BLEEDING:
+    case LastingEffect::REGENERATION:
+    case LastingEffect::ON_FIRE:
+    case LastingEffect::PLAGUE:
+    case LastingEffect::POISON:
+    case LastingEffect::WARNING:
+    case LastingEffect::SUNLIGHT_VULNERABLE:
+    case LastingEffect::ENTERTAINER:
+    case LastingEffect::BAD_BREATH:
+    case LastingEffect::DISAPPEAR_DURING_DAY:
+      return true;
+    default:
+      return false;
+  }
+}
+
 string LastingEffects::getName(LastingEffect type) {
   switch (type) {
     case LastingEffect::PREGNANT: return "pregnant";
@@ -106,6 +106,8 @@ class LastingEffects {
   static int getAttrBonus(const Creature*, AttrType);
   static void afterCreatureDamage(Creature*, LastingEffect);
   static bool tick(Creature*, LastingEffect);
+  /** Returns false if tick() never does anything for the effect.*/
+  static bool hasTick(LastingEffect);
   static optional<string> getGoodAdjective(LastingEffect);
   static optional<string> getBadAdjective(LastingEffect);
   static const vector<LastingEffect>& getCausingCondition(CreatureCondition);
@@ -44,6 +44,7 @@
 template <class Archive>
 void Level::serialize(Archive& ar, const unsigned int version) {
   ar & SUBCLASS(OwnedObject<Level>);
+  flushLightChanges();
   ar(squares, landingSquares, tickingSquares, creatures, model, fieldOfView);
   ar(sunlight, bucketMap, lightAmount, unavailable, swarmMaps);
   ar(levelId, noDiagonalPassing, lightCapAmount, creatureIds, memoryUpdates);
@@ -112,6 +113,7 @@ PLevel Level::create(SquareArray s, FurnitureArray f, WModel m,
           pos.modFurniture(layer)->getViewObject()->setId(*viewId);
       }
   }
+  ret->flushLightChanges();
   ret->unavailable = std::move(unavailable);
   ret->covered = std::move(covered);
   ret->getSectors({MovementTrait::WALK});
@@ -156,30 +158,53 @@ void Level::removeLightSource(Vec2 pos, double radius) {
   addLightSource(pos, radius, -1);
 }
 
+bool Level::LightChange::operator < (const LightChange& o) const {
+  return std::forward_as_tuple(pos, radius, darkness) < std::forward_as_tuple(o.pos, o.radius, o.darkness);
+}
+
 void Level::addLightSource(Vec2 pos, double radius, int numLight) {
-  PROFILE;
-  if (radius > 0) {
-    for (Vec2 v : getVisibleTilesNoDarkness(pos, VisionId::NORMAL)) {
-      double dist = (v - pos).lengthD();
-      if (dist <= radius) {
-        lightAmount[v] += min(1.0, 1 - (dist) / radius) * numLight;
-        setNeedsRenderUpdate(v, true);
-      }
-    }
-  }
+  if (radius > 0)
+    pendingLightChanges[LightChange{pos, radius, false}] += numLight;
 }
 
 void Level::addDarknessSource(Vec2 pos, double radius, int numDarkness) {
-  if (radius > 0) {
-    for (Vec2 v : getVisibleTilesNoDarkness(pos, VisionId::NORMAL)) {
-      double dist = (v - pos).lengthD();
-      if (dist <= radius) {
-        lightCapAmount[v] -= min(1.0, 1 - (dist) / radius) * numDarkness;
-        setNeedsRenderUpdate(v, true);
+  if (radius > 0)
+    pendingLightChanges[LightChange{pos, radius, true}] += numDarkness;
+}
+
+// Fixed point amounts of light at each offset from the source, indexed from (-radius, -radius).
+static const Table<int>& getLightKernel(double radius) {
+  static thread_local map<double, Table<int>> kernels;
+  if (auto ret = getReferenceMaybe(kernels, radius))
+    return *ret;
+  int size = int(radius);
+  Table<int> kernel(Rectangle(-size, -size, size + 1, size + 1), 0);
+  for (Vec2 v : kernel.getBounds()) {
+    double dist = v.lengthD();
+    if (dist <= radius)
+      kernel[v] = LightMap::toFixedPoint(min(1.0, 1 - dist / radius));
+  }
+  return kernels[radius] = std::move(kernel);
+}
+
+void Level::flushLightChanges() {
+  PROFILE;
+  for (auto& elem : pendingLightChanges)
+    if (int num = elem.second) {
+      auto& change = elem.first;
+      auto& kernel = getLightKernel(change.radius);
+      auto& lightMap = change.darkness ? lightCapAmount : lightAmount;
+      // Darkness lowers the cap on light instead of adding to it.
+      int sign = change.darkness ? -num : num;
+      for (Vec2 v : getFieldOfView(VisionId::NORMAL).getVisibleTiles(change.pos, int(change.radius))) {
+        Vec2 offset = v - change.pos;
+        if (offset.lengthD() <= change.radius) {
+          lightMap.add(v, kernel[offset] * sign);
+          setNeedsRenderUpdate(v, true);
+        }
       }
-//      updateConnectivity(v);
     }
-  }
+  pendingLightChanges.clear();
 }
 
 void Level::updateCreatureLight(Vec2 pos, int diff) {
@@ -194,17 +219,21 @@ void Level::updateCreatureLight(Vec2 pos, int diff) {
 }
 
 void Level::updateVisibility(Vec2 changedSquare) {
+  // Queued light changes must be applied with the field of view they were made with.
+  flushLightChanges();
   auto allVisible = getVisibleTilesNoDarkness(changedSquare, VisionId::NORMAL);
   for (Vec2 pos : allVisible) {
     addLightSource(pos, Position(pos, this).getLightEmission(), -1);
     updateCreatureLight(pos, -1);
   }
+  flushLightChanges();
   for (VisionId vision : ENUM_ALL(VisionId))
     getFieldOfView(vision).squareChanged(changedSquare);
   for (Vec2 pos : allVisible) {
     addLightSource(pos, Position(pos, this).getLightEmission(), 1);
     updateCreatureLight(pos, 1);
   }
+  flushLightChanges();
   for (Vec2 pos : allVisible)
     getModel()->addEvent(EventInfo::VisibilityChanged{Position(pos, this)});
 }
@@ -228,12 +257,12 @@ bool Level::isCovered(Vec2 pos) const {
 }
 
 bool Level::isInSunlight(Vec2 pos) const {
-  return !isCovered(pos) && lightCapAmount[pos] >= 1 &&
+  return !isCovered(pos) && lightCapAmount.get(pos) >= 1 &&
       getGame()->getSunlightInfo().getState() == SunlightState::DAY;
 }
 
 double Level::getLight(Vec2 pos) const {
-  return min(1.0, max(0.0, min(isCovered(pos) ? 1.0 : lightCapAmount[pos], lightAmount[pos] +
+  return min(1.0, max(0.0, min(isCovered(pos) ? 1.0 : lightCapAmount.get(pos), lightAmount.get(pos) +
       sunlight[pos] * getGame()->getSunlightInfo().getLightAmount())));
 }
 
@@ -422,6 +451,10 @@ FieldOfView& Level::getFieldOfView(VisionId vision) const {
   return (*fieldOfView)[vision];
 }
 
+const VisibilityCacheStats& Level::getVisibilityCacheStats(VisionId vision) const {
+  return getFieldOfView(vision).getCacheStats();
+}
+
 bool Level::canSee(Vec2 from, Vec2 to, const Vision& vision) const {
   //PROFILE_BLOCK("Level::canSee");
   return isWithinVision(from, to, vision) && getFieldOfView(vision.getId()).canSee(from, to);
@@ -499,7 +532,7 @@ void Level::swapCreatures(Creature* c1, Creature* c2) {
   placeCreature(c2, pos1);
 }
 
-const vector<SVec2>& Level::getVisibleTilesNoDarkness(Vec2 pos, VisionId vision) const {
+vector<SVec2> Level::getVisibleTilesNoDarkness(Vec2 pos, VisionId vision) const {
   PROFILE;
   return getFieldOfView(vision).getVisibleTiles(pos);
 }
@@ -544,6 +577,7 @@ void Level::addTickingFurniture(Vec2 pos) {
 
 void Level::tick() {
   PROFILE_BLOCK("Level::tick");
+  flushLightChanges();
   for (Vec2 pos : tickingSquares)
     squares->getWritable(pos)->tick(Position(pos, this));
   for (Vec2 pos : tickingFurniture)
@@ -587,14 +621,75 @@ Sectors& Level::getSectors(const MovementType& movement) const {
   }
 }
 
+ClusterGraph& Level::getClusterGraph(const MovementType& movement) const {
+  if (auto res = getReferenceMaybe(clusterGraphs, movement))
+    return *res;
+  else {
+    clusterGraphs.insert(make_pair(movement, ClusterGraph(getBounds())));
+    return clusterGraphs.at(movement);
+  }
+}
+
+FlowFieldCache& Level::getFlowFields() const {
+  return flowFields;
+}
+
+static MovementType getWithoutDestroying(const MovementType& movement) {
+  return copyOf(movement).setCanBuildBridge(false).setDestroyActions({});
+}
+
+double Level::calcNavigationCost(Vec2 pos, const MovementType& movement) const {
+  if (!getSectorsDontCreate(movement).contains(pos))
+    return NavigationCostGrid::infinity;
+  auto& movementSectors = getSectorsDontCreate(getWithoutDestroying(movement));
+  // Creatures move all the time, so the searches add their penalty on top of the grid.
+  if (movementSectors.contains(pos))
+    return 1.0;
+  return Position(pos, getThis().removeConst().get()).getNavigationCost(movement, movementSectors);
+}
+
+const NavigationCostGrid& Level::getNavigationCosts(const MovementType& movement) const {
+  if (auto res = getReferenceMaybe(navigationCosts, movement))
+    return *res;
+  else {
+    PROFILE_BLOCK("Gen navigation costs");
+    // Both sectors must exist from now on, so that updateConnectivity refreshes them before the costs.
+    getSectors(movement);
+    getSectors(getWithoutDestroying(movement));
+    NavigationCostGrid grid(getBounds());
+    for (Vec2 v : getBounds())
+      grid.set(v, calcNavigationCost(v, movement));
+    navigationCosts.insert(make_pair(movement, std::move(grid)));
+    return navigationCosts.at(movement);
+  }
+}
+
+void Level::updateNavigationCosts(Vec2 pos) {
+  for (auto& elem : navigationCosts)
+    if (elem.second.set(pos, calcNavigationCost(pos, elem.first))) {
+      // The edges of the cluster graph and the flow fields were computed from the old cost.
+      if (auto graph = getReferenceMaybe(clusterGraphs, elem.first))
+        graph->invalidate(pos);
+      flowFields.clear(elem.first);
+    }
+}
+
 bool Level::isChokePoint(Vec2 pos, const MovementType& movement) const {
   return getSectors(movement).isChokePoint(pos);
 }
 
 void Level::updateSunlightMovement() {
   for (auto movement : getKeys(sectors))
-    if (movement.isSunlightVulnerable())
+    if (movement.isSunlightVulnerable()) {
       sectors.erase(movement);
+      flowFields.clear(movement);
+    }
+  for (auto movement : getKeys(clusterGraphs))
+    if (movement.isSunlightVulnerable())
+      clusterGraphs.erase(movement);
+  for (auto movement : getKeys(navigationCosts))
+    if (movement.isSunlightVulnerable())
+      navigationCosts.erase(movement);
 }
 
 int Level::getNumGeneratedSquares() const {
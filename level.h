@@ -20,6 +20,10 @@
 #include "unique_entity.h"
 #include "movement_type.h"
 #include "sectors.h"
+#include "cluster_graph.h"
+#include "flow_field.h"
+#include "navigation_cost_grid.h"
+#include "light_map.h"
 #include "stair_key.h"
 #include "entity_set.h"
 #include "vision_id.h"
@@ -42,6 +46,7 @@ class SquareArray;
 class FurnitureArray;
 class Vision;
 class FieldOfView;
+struct VisibilityCacheStats;
 class Portals;
 class RoofSupport;
 
@@ -130,6 +135,10 @@ class Level : public OwnedObject<Level> {
   void addLightSource(Vec2, double radius);
   void removeLightSource(Vec2, double radius);
 
+  /** Applies the queued light source changes. Light is read from the last flush, which happens every tick
+      and before every creature's move.*/
+  void flushLightChanges();
+
   /** Returns the amount of light in the square, capped within (0, 1).*/
   double getLight(Vec2) const;
 
@@ -153,6 +162,10 @@ class Level : public OwnedObject<Level> {
   void setFurniture(Vec2, PFurniture);
 
   Sectors& getSectors(const MovementType&) const;
+  ClusterGraph& getClusterGraph(const MovementType&) const;
+  FlowFieldCache& getFlowFields() const;
+  const VisibilityCacheStats& getVisibilityCacheStats(VisionId) const;
+  const NavigationCostGrid& getNavigationCosts(const MovementType&) const;
   struct EffectSet {
     vector<LastingEffect> SERIAL(friendly);
     vector<LastingEffect> SERIAL(hostile);
@@ -189,11 +202,24 @@ class Level : public OwnedObject<Level> {
   HeapAllocated<RoofSupport> SERIAL(roofSupport);
   HeapAllocated<CreatureBucketMap> SERIAL(bucketMap);
   vector<pair<int, CreatureBucketMap>> SERIAL(swarmMaps);
-  Table<double> SERIAL(lightAmount);
-  Table<double> SERIAL(lightCapAmount);
+  LightMap SERIAL(lightAmount);
+  LightMap SERIAL(lightCapAmount);
+  struct LightChange {
+    Vec2 pos;
+    double radius;
+    bool darkness;
+    bool operator < (const LightChange&) const;
+  };
+  // Light source changes since the last flush, merged so that a source removed and added back cancels out.
+  map<LightChange, int> pendingLightChanges;
   EnumMap<TribeId::KeyType, unique_ptr<EffectsTable>> SERIAL(furnitureEffects);
   mutable unordered_map<MovementType, Sectors, CustomHash<MovementType>> sectors;
+  mutable unordered_map<MovementType, ClusterGraph, CustomHash<MovementType>> clusterGraphs;
+  mutable FlowFieldCache flowFields;
+  mutable unordered_map<MovementType, NavigationCostGrid, CustomHash<MovementType>> navigationCosts;
   Sectors& getSectorsDontCreate(const MovementType&) const;
+  double calcNavigationCost(Vec2, const MovementType&) const;
+  void updateNavigationCosts(Vec2);
 
   friend class LevelBuilder;
   struct Private {};
@@ -208,7 +234,7 @@ class Level : public OwnedObject<Level> {
   void addLightSource(Vec2 pos, double radius, int numLight);
   void addDarknessSource(Vec2 pos, double radius, int numLight);
   FieldOfView& getFieldOfView(VisionId vision) const;
-  const vector<SVec2>& getVisibleTilesNoDarkness(Vec2 pos, VisionId vision) const;
+  vector<SVec2> getVisibleTilesNoDarkness(Vec2 pos, VisionId vision) const;
   bool isWithinVision(Vec2 from, Vec2 to, const Vision&) const;
   LevelId SERIAL(levelId) = 0;
   bool SERIAL(noDiagonalPassing) = false;
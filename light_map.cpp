@@ -0,0 +1,9 @@
+#include "stdafx.h"
+#include "light_map.h"
+
+LightMap::LightMap(Rectangle bounds, double initial) : values(bounds, toFixedPoint(initial)) {
+}
+
+int LightMap::toFixedPoint(double value) {
+  return int(std::lround(value * unit));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "util.h"
+
+/** Per-tile light values kept in fixed point, so that adding and later removing the same light source
+    always restores the exact previous value. Saved in the same format as a Table<double>.*/
+class LightMap {
+  public:
+  LightMap(Rectangle bounds, double initial);
+
+  static constexpr int unit = 1 << 16;
+
+  double get(Vec2 v) const {
+    return double(values[v]) / unit;
+  }
+
+  void add(Vec2 v, int amount) {
+    values[v] += amount;
+  }
+
+  template <class Archive>
+  void save(Archive& ar) const {
+    Table<double> table(values.getBounds());
+    for (Vec2 v : values.getBounds())
+      table[v] = get(v);
+    ar(table);
+  }
+
+  template <class Archive>
+  void load(Archive& ar) {
+    Table<double> table;
+    ar(table);
+    values = Table<int>(table.getBounds());
+    for (Vec2 v : values.getBounds())
+      values[v] = toFixedPoint(table[v]);
+  }
+
+  static int toFixedPoint(double);
+
+  SERIALIZATION_CONSTRUCTOR(LightMap)
+
+  private:
+  Table<int> values;
+};
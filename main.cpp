@@ -37,6 +37,7 @@
 #include "clock.h"
 #include "skill.h"
 #include "parse_game.h"
+#include "gzstream.h"
 #include "version.h"
 #include "vision.h"
 #include "model_builder.h"
@@ -57,6 +58,9 @@
 #include "fx_manager.h"
 #include "fx_renderer.h"
 #include "fx_view_manager.h"
+#include "shortest_path.h"
+#include "field_of_view.h"
+#include "creature.h"
 
 #ifndef VSTUDIO
 #include "stack_printer.h"
@@ -219,6 +223,8 @@ static po::parser getCommandLineFlags() {
   flags["battle_rounds"].type(po::i32).description("Number of battle rounds");
   flags["stderr"].description("Log to stderr");
   flags["nolog"].description("No logging");
+  flags["log_categories"].type(po::string).description("Comma separated list of source files to log from, e.g. creature,model");
+  flags["log_exclude"].type(po::string).description("Comma separated list of source files not to log from");
   flags["free_mode"].description("Run in free ascii mode");
   flags["simple_game"].description("Start \"simple game\"");
 #ifndef RELEASE
@@ -226,6 +232,16 @@ static po::parser getCommandLineFlags() {
   flags["max_turns"].type(po::i32).description("Quit the game after a given max number of turns");
 #endif
   flags["seed"].type(po::i32).description("Use given seed");
+  flags["exact_pathfinding"].description("Don't use the cluster graph and flow fields in pathfinding");
+  flags["path_benchmark"].type(po::string).description("Compare pathfinding on the levels of a save file and exit");
+  flags["path_benchmark_paths"].type(po::i32).description("Number of paths per level in path benchmark");
+  flags["path_microbenchmark"].type(po::i32).description("Compare path search engines on generated dungeons and exit");
+  flags["bench_save"].type(po::string).description("Run the turns of a save file without rendering, print the timings as JSON and exit");
+  flags["bench_turns"].type(po::i32).description("Number of turns to run in the save benchmark");
+  flags["fov_cache_kb"].type(po::i32).description("Memory budget of the field of view cache of each level and vision");
+  flags["verify_dormant_ticks"].description("Run the full tick on dormant creatures and check that nothing changed");
+  flags["no_fork_autosave"].description("Autosave on the game process instead of a forked one");
+  flags["profile"].type(po::string).description("Record profiling events and write them to the given file in the Chrome trace format on exit");
   flags["record"].type(po::string).description("Record game to file");
   flags["replay"].type(po::string).description("Replay game from file");
   return flags;
@@ -308,6 +324,12 @@ struct AppConfig {
 
 static int keeperMain(po::parser& commandLineFlags) {
   ENABLE_PROFILER;
+  if (commandLineFlags["profile"].was_set())
+    Profiler::setEnabled(true);
+  DestructorFunction exportProfile([&] {
+    if (commandLineFlags["profile"].was_set())
+      Profiler::exportChromeTrace(commandLineFlags["profile"].get().string);
+  });
   if (commandLineFlags["help"].was_set()) {
     std::cout << commandLineFlags << endl;
     return 0;
@@ -334,6 +356,17 @@ static int keeperMain(po::parser& commandLineFlags) {
       [](const string& s) { ofstream("stacktrace.out") << s << "\n" << std::flush; } ));
   if (commandLineFlags["stderr"].was_set() || commandLineFlags["run_tests"].was_set())
     InfoLog.addOutput(DebugOutput::toStream(std::cerr));
+  if (commandLineFlags["log_categories"].was_set()) {
+    DebugLog::setDefaultCategoryEnabled(false);
+    for (auto& category : split(commandLineFlags["log_categories"].get().string, {','}))
+      DebugLog::setCategoryEnabled(category, true);
+  }
+  if (commandLineFlags["log_exclude"].was_set())
+    for (auto& category : split(commandLineFlags["log_exclude"].get().string, {','}))
+      DebugLog::setCategoryEnabled(category, false);
+  InfoLog.startWriterThread();
+  // The outputs don't outlive this function.
+  DestructorFunction stopLogWriter([] { InfoLog.stopWriterThread(); });
   Skill::init();
   if (commandLineFlags["run_tests"].was_set()) {
     testAll();
@@ -380,6 +413,16 @@ static int keeperMain(po::parser& commandLineFlags) {
   Options options(settingsPath);
   int seed = commandLineFlags["seed"].was_set() ? commandLineFlags["seed"].get().i32 : int(time(nullptr));
   Random.init(seed);
+  if (commandLineFlags["exact_pathfinding"].was_set()) {
+    LevelShortestPath::useClusterGraph = false;
+    LevelShortestPath::useFlowFields = false;
+  }
+  if (commandLineFlags["fov_cache_kb"].was_set())
+    FieldOfView::setCacheBudget(size_t(commandLineFlags["fov_cache_kb"].get().i32) * 1024);
+  if (commandLineFlags["no_fork_autosave"].was_set())
+    MainLoop::forkAutosave = false;
+  if (commandLineFlags["verify_dormant_ticks"].was_set())
+    Creature::setVerifyDormantTicks(true);
   auto installId = getInstallId(userPath.file("installId.txt"), Random);
   SoundLibrary* soundLibrary = nullptr;
   AudioDevice audioDevice;
@@ -448,6 +491,28 @@ static int keeperMain(po::parser& commandLineFlags) {
       }
     } catch (GameExitException) {}
   };
+  if (commandLineFlags["path_microbenchmark"].was_set()) {
+    MainLoop loop(nullptr, &highscores, &fileSharing, freeDataPath, userPath, modsDir, &options, &jukebox, &sokobanInput,
+        nullptr, true, 0, "");
+    loop.pathfindingMicrobenchmark(commandLineFlags["path_microbenchmark"].get().i32);
+    return 0;
+  }
+  if (commandLineFlags["path_benchmark"].was_set()) {
+    MainLoop loop(nullptr, &highscores, &fileSharing, freeDataPath, userPath, modsDir, &options, &jukebox, &sokobanInput,
+        nullptr, true, 0, "");
+    int numPaths = commandLineFlags["path_benchmark_paths"].was_set()
+        ? commandLineFlags["path_benchmark_paths"].get().i32 : 200;
+    loop.pathfindingBenchmark(FilePath::fromFullPath(commandLineFlags["path_benchmark"].get().string), numPaths);
+    return 0;
+  }
+  if (commandLineFlags["bench_save"].was_set()) {
+    DummyView dummyView(&clock);
+    MainLoop loop(&dummyView, &highscores, &fileSharing, freeDataPath, userPath, modsDir, &options, &jukebox,
+        &sokobanInput, nullptr, true, 0, "");
+    int numTurns = commandLineFlags["bench_turns"].was_set() ? commandLineFlags["bench_turns"].get().i32 : 500;
+    loop.turnBenchmark(FilePath::fromFullPath(commandLineFlags["bench_save"].get().string), numTurns);
+    return 0;
+  }
   if (commandLineFlags["battle_level"].was_set() && !commandLineFlags["battle_view"].was_set()) {
     battleTest(new DummyView(&clock), nullptr);
     return 0;
@@ -502,6 +567,7 @@ static int keeperMain(po::parser& commandLineFlags) {
       {renderer, guiFactory, tilesPresent, &options, &clock, soundLibrary, &bugreportSharing, userPath, installId}));
 #ifndef RELEASE
   InfoLog.addOutput(DebugOutput::toString([&view](const string& s) { view->logMessage(s);}));
+  DestructorFunction stopLogWriterBeforeView([] { InfoLog.stopWriterThread(); });
 #endif
   unique_ptr<fx::FXManager> fxManager;
   unique_ptr<fx::FXRenderer> fxRenderer;
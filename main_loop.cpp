@@ -46,22 +46,34 @@
 #include "extern/iomanip.h"
 #include "enemy_info.h"
 #include "level.h"
+#include "shortest_path.h"
 #include "simple_game.h"
 #include "monster_ai.h"
 #include "mem_usage_counter.h"
 #include "gui_elem.h"
 #include "encyclopedia.h"
+#include "subsystem_timer.h"
+#include "memory_telemetry.h"
+#include "field_of_view.h"
+#include "vision_id.h"
 
 #ifdef USE_STEAMWORKS
 #include "steam_ugc.h"
 #include "steam_client.h"
 #endif
 
+#ifdef __linux__
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
 MainLoop::MainLoop(View* v, Highscores* h, FileSharing* fSharing, const DirectoryPath& freePath,
     const DirectoryPath& uPath, const DirectoryPath& modsDir, Options* o, Jukebox* j, SokobanInput* soko,
     TileSet* tileSet, bool singleThread, int sv, string modVersion)
       : view(v), dataFreePath(freePath), userPath(uPath), modsDir(modsDir), options(o), jukebox(j), highscores(h), fileSharing(fSharing),
-        useSingleThread(singleThread), sokobanInput(soko), tileSet(tileSet), saveVersion(sv), modVersion(modVersion) {
+        useSingleThread(singleThread), sokobanInput(soko), tileSet(tileSet), saveVersion(sv), modVersion(modVersion),
+        saveFileIndex(userPath.file("save_index.dat")) {
 }
 
 vector<SaveFileInfo> MainLoop::getSaveFiles(const DirectoryPath& path, const string& suffix) {
@@ -124,12 +136,17 @@ static string stripFilename(string s) {
   return s;
 }
 
-void MainLoop::saveGame(PGame& game, const FilePath& path) {
-  CompressedOutput out(path.getPath());
+bool MainLoop::saveGame(PGame& game, const FilePath& path, optional<FilePath> previous) {
+  CompressedOutput out(path.getPath(), previous ? previous->getPath() : nullptr);
+  // Objects that didn't change are then saved as the same bytes, so the chunks that contain them can be reused.
+  out.getArchive().setStablePointerIds(!!previous);
   string name = game->getGameDisplayName();
   SavedGameInfo savedInfo = game->getSavedGameInfo(tileSet->getSpriteMods());
+  // The menus read the copy in the uncompressed header. The values are still saved in the stream for older readers.
+  out.getStream().setHeader(getSaveHeader(saveVersion, name, savedInfo));
   out.getArchive() << saveVersion << name << savedInfo;
   out.getArchive() << game;
+  return out.getStream().close();
 }
 
 struct RetiredModelInfo {
@@ -142,6 +159,7 @@ void MainLoop::saveMainModel(PGame& game, const FilePath& path) {
   CompressedOutput out(path.getPath());
   string name = game->getGameDisplayName();
   SavedGameInfo savedInfo = game->getSavedGameInfo(tileSet->getSpriteMods());
+  out.getStream().setHeader(getSaveHeader(saveVersion, name, savedInfo));
   out.getArchive() << saveVersion << name << savedInfo;
   RetiredModelInfo info {
     std::move(game->getMainModel()),
@@ -151,7 +169,7 @@ void MainLoop::saveMainModel(PGame& game, const FilePath& path) {
 }
 
 int MainLoop::getSaveVersion(const SaveFileInfo& save) {
-  if (auto info = getNameAndVersion(userPath.file(save.filename)))
+  if (auto info = saveFileIndex.getNameAndVersion(userPath.file(save.filename)))
     return info->second;
   else
     return -1;
@@ -181,6 +199,30 @@ FilePath MainLoop::getSavePath(const PGame& game, GameSaveType gameType) {
   return userPath.file(stripFilename(game->getGameIdentifier()) + getSaveSuffix(gameType));
 }
 
+static FilePath getTemporarySavePath(const FilePath& path) {
+  return FilePath::fromFullPath(path.getPath() + ".tmp"_s);
+}
+
+static void removeSaveFile(const FilePath& path) {
+  remove(path.getPath());
+  remove(getChunkIndexPath(path.getPath()).c_str());
+}
+
+// The old chunk index is removed first, so it's never paired with the new file.
+static bool replaceSaveFile(const FilePath& from, const FilePath& to) {
+  remove(getChunkIndexPath(to.getPath()).c_str());
+  if (rename(from.getPath(), to.getPath()) != 0)
+    return false;
+  rename(getChunkIndexPath(from.getPath()).c_str(), getChunkIndexPath(to.getPath()).c_str());
+  return true;
+}
+
+// Checks a newly written save before it replaces the previous one.
+static bool isSaveComplete(const FilePath& path, int saveVersion) {
+  auto info = getNameAndVersion(path);
+  return info && info->second == saveVersion && isCompressedFileValid(path.getPath());
+}
+
 void MainLoop::saveUI(PGame& game, GameSaveType type) {
   auto path = getSavePath(game, type);
   function<void()> uploadFun = nullptr;
@@ -198,18 +240,89 @@ void MainLoop::saveUI(PGame& game, GameSaveType type) {
         });
   } else {
     int saveTime = game->getSaveProgressCount();
+    auto tmpPath = getTemporarySavePath(path);
+    bool saved = false;
     doWithSplash(type == GameSaveType::AUTOSAVE ? "Autosaving" : "Saving game...", saveTime,
         [&] (ProgressMeter& meter) {
         Square::progressMeter = &meter;
-        MEASURE(saveGame(game, path), "saving time")});
+        MEASURE(saved = saveGame(game, tmpPath, path), "saving time")});
+    // The previous save is kept if the new one is broken.
+    if (!saved || !isSaveComplete(tmpPath, saveVersion) || !replaceSaveFile(tmpPath, path)) {
+      removeSaveFile(tmpPath);
+      view->presentText("Sorry", "Failed to save the game.");
+    }
   }
   Square::progressMeter = nullptr;
   if (uploadFun)
     uploadFun();
 }
 
+bool MainLoop::forkAutosave = true;
+
+#ifdef __linux__
+// The game waits this long for the forked autosave before falling back to saving on the main process.
+static const auto forkedAutosaveTimeout = milliseconds(120000);
+#endif
+
+bool MainLoop::startForkedAutosave(PGame& game) {
+#ifdef __linux__
+  if (!forkAutosave)
+    return false;
+  if (autosaveProcess && !*pollForkedAutosave(true))
+    return false;
+  auto path = getSavePath(game, GameSaveType::AUTOSAVE);
+  auto tmpPath = getTemporarySavePath(path);
+  auto pid = fork();
+  if (pid == -1)
+    return false;
+  if (pid == 0) {
+    // Only this thread exists in the child, so it mustn't touch anything that other threads might have locked.
+    DebugLog::disableInForkedChild();
+    Profiler::setEnabled(false);
+    bool success = false;
+    try {
+      success = saveGame(game, tmpPath, path) && isSaveComplete(tmpPath, saveVersion) &&
+          replaceSaveFile(tmpPath, path);
+    } catch (...) {}
+    _exit(success ? 0 : 1);
+  }
+  autosaveProcess = pid;
+  autosaveTmpPath = tmpPath;
+  return true;
+#else
+  return false;
+#endif
+}
+
+optional<bool> MainLoop::pollForkedAutosave(bool wait) {
+#ifdef __linux__
+  if (!autosaveProcess)
+    return none;
+  int status = 0;
+  auto res = waitpid(*autosaveProcess, &status, WNOHANG);
+  for (auto start = steady_clock::now(); res == 0 && wait; res = waitpid(*autosaveProcess, &status, WNOHANG))
+    if (steady_clock::now() - start > forkedAutosaveTimeout) {
+      INFO << "Forked autosave timed out";
+      kill(*autosaveProcess, SIGKILL);
+      waitpid(*autosaveProcess, &status, 0);
+      res = -1;
+      break;
+    } else
+      sleep_for(milliseconds(10));
+  if (res == 0)
+    return none;
+  autosaveProcess = none;
+  bool success = res > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (!success)
+    removeSaveFile(*autosaveTmpPath);
+  return success;
+#else
+  return none;
+#endif
+}
+
 void MainLoop::eraseSaveFile(const PGame& game, GameSaveType type) {
-  remove(getSavePath(game, type).getPath());
+  removeSaveFile(getSavePath(game, type));
 }
 
 void MainLoop::getSaveOptions(const vector<pair<GameSaveType, string>>& games, vector<ListElem>& options,
@@ -222,7 +335,7 @@ void MainLoop::getSaveOptions(const vector<pair<GameSaveType, string>>& games, v
       options.emplace_back(elem.second, ListElem::TITLE);
       append(options, files.transform(
           [this] (const SaveFileInfo& info) {
-              auto nameAndVersion = getNameAndVersion(userPath.file(info.filename));
+              auto nameAndVersion = saveFileIndex.getNameAndVersion(userPath.file(info.filename));
               return ListElem(nameAndVersion->first, getDateString(info.date));}));
     }
   }
@@ -274,6 +387,7 @@ MainLoop::ExitCondition MainLoop::playGame(PGame game, bool withMusic, bool noAu
   OnExit on_exit([&]() {
     if (!splashScreen)
       registerModPlaytime(false);
+    pollForkedAutosave(true);
   });
   if (tileSet)
     tileSet->setTilePaths(game->getContentFactory()->tilePaths);
@@ -319,6 +433,7 @@ MainLoop::ExitCondition MainLoop::playGame(PGame game, bool withMusic, bool noAu
     }
     INFO << "Time step " << step;
     if (auto exitInfo = game->update(step)) {
+      pollForkedAutosave(true);
       exitInfo->visit(
           [&](ExitAndQuit) {
             eraseAllSavesExcept(game, none);
@@ -347,12 +462,19 @@ MainLoop::ExitCondition MainLoop::playGame(PGame game, bool withMusic, bool noAu
       lastMusicUpdate = gameTime;
     }
     if (lastAutoSave < gameTime - TimeInterval(options->getIntValue(OptionId::AUTOSAVE2)) && !noAutoSave) {
-      if (options->getBoolValue(OptionId::AUTOSAVE2)) {
+      if (options->getBoolValue(OptionId::AUTOSAVE2) && !startForkedAutosave(game)) {
         saveUI(game, GameSaveType::AUTOSAVE);
         eraseAllSavesExcept(game, GameSaveType::AUTOSAVE);
       }
       lastAutoSave = gameTime;
     }
+    if (auto autosaved = pollForkedAutosave(false)) {
+      if (!*autosaved) {
+        INFO << "Forked autosave failed, saving on the main process";
+        saveUI(game, GameSaveType::AUTOSAVE);
+      }
+      eraseAllSavesExcept(game, GameSaveType::AUTOSAVE);
+    }
     view->refreshView();
   }
 }
@@ -369,11 +491,11 @@ optional<RetiredGames> MainLoop::getRetiredGames(CampaignType type) {
       RetiredGames ret;
       for (auto& info : getSaveFiles(userPath, getSaveSuffix(GameSaveType::RETIRED_CAMPAIGN)))
         if (isCompatible(getSaveVersion(info)))
-          if (auto saved = loadSavedGameInfo(userPath.file(info.filename)))
+          if (auto saved = saveFileIndex.getSavedGameInfo(userPath.file(info.filename)))
             ret.addLocal(*saved, info, true);
       for (auto& info : getSaveFiles(userPath, getSaveSuffix(GameSaveType::RETIRED_SITE)))
         if (isCompatible(getSaveVersion(info)))
-          if (auto saved = loadSavedGameInfo(userPath.file(info.filename)))
+          if (auto saved = saveFileIndex.getSavedGameInfo(userPath.file(info.filename)))
             if (!saved->retiredEnemyInfo)
               ret.addLocal(*saved, info, false);
       vector<FileSharing::SiteInfo> onlineSites;
@@ -995,6 +1117,236 @@ void MainLoop::endlessTest(int numTries, const FilePath& levelPath, const FilePa
     }
 }
 
+void MainLoop::pathfindingBenchmark(const FilePath& savePath, int numPaths) {
+  PGame game = loadGame(savePath);
+  if (!game) {
+    std::cout << "Failed to load " << savePath << std::endl;
+    return;
+  }
+  RandomGen random;
+  random.init(0);
+  LevelShortestPath::useFlowFields = false;
+  MovementType movement({MovementTrait::WALK});
+  auto levels = game->getMainModel()->getLevels();
+  for (int levelIndex : All(levels)) {
+    auto level = levels[levelIndex];
+    auto& sectors = level->getSectors(movement);
+    auto largestSector = sectors.getLargest();
+    auto positions = level->getAllPositions().filter([&](Position pos) {
+      return sectors.isSector(pos.getCoord(), largestSector);
+    });
+    if (positions.empty())
+      continue;
+    vector<pair<Position, Position>> queries;
+    for (int i : Range(100 * numPaths)) {
+      auto from = random.choose(positions);
+      auto to = random.choose(positions);
+      if (*from.dist8(to) >= 40)
+        queries.push_back(make_pair(from, to));
+      if (queries.size() >= numPaths)
+        break;
+    }
+    if (queries.empty())
+      continue;
+    auto measure = [&] (const string& name, bool useClusterGraph) {
+      LevelShortestPath::useClusterGraph = useClusterGraph;
+      long long numExpanded = 0;
+      long long pathLength = 0;
+      auto time = steady_clock::now();
+      for (auto& query : queries) {
+        LevelShortestPath path(query.first, movement, query.second);
+        numExpanded += path.getNumExpanded();
+        pathLength += path.getPath().size();
+      }
+      auto micros = duration_cast<microseconds>(steady_clock::now() - time).count();
+      std::cout << name << ": " << micros / queries.size() << " us/path, " << numExpanded / queries.size()
+          << " nodes expanded/path, " << pathLength / queries.size() << " tiles/path" << std::endl;
+    };
+    std::cout << "Level " << levelIndex << ", " << queries.size() << " paths" << std::endl;
+    measure("Exact", false);
+    measure("Cluster graph (cold)", true);
+    measure("Cluster graph (warm)", true);
+    vector<LevelShortestPath::Request> requests;
+    for (auto& query : queries)
+      requests.push_back(LevelShortestPath::Request{query.first, movement, query.second});
+    optional<vector<vector<Position>>> serialPaths;
+    for (int numThreads : {1, max<int>(2, thread::hardware_concurrency())}) {
+      auto time = steady_clock::now();
+      auto paths = LevelShortestPath::findPaths(requests, numThreads).transform(
+          [](const LevelShortestPath& path) { return path.getPath(); });
+      auto micros = duration_cast<microseconds>(steady_clock::now() - time).count();
+      std::cout << "Exact batch, " << numThreads << " threads: " << micros / queries.size() << " us/path" << std::endl;
+      if (!serialPaths)
+        serialPaths = paths;
+      else
+        CHECK(paths == *serialPaths) << "Batched paths depend on the number of threads";
+    }
+  }
+  LevelShortestPath::useClusterGraph = true;
+  LevelShortestPath::useFlowFields = true;
+}
+
+static string escapeJson(const string& s) {
+  string ret;
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      ret += '\\';
+    ret += c;
+  }
+  return ret;
+}
+
+void MainLoop::turnBenchmark(const FilePath& savePath, int numTurns) {
+  auto loadStart = steady_clock::now();
+  PGame game = loadGame(savePath);
+  double loadMillis = duration_cast<microseconds>(steady_clock::now() - loadStart).count() / 1000.0;
+  if (!game) {
+    std::cerr << "Failed to load " << savePath << std::endl;
+    return;
+  }
+  Encyclopedia encyclopedia(game->getContentFactory());
+  game->initialize(options, highscores, view, fileSharing, &encyclopedia);
+  game->initializeModels();
+  if (game->isTurnBased()) {
+    std::cerr << "The benchmark can't run a game with a player controlled creature" << std::endl;
+    return;
+  }
+  SubsystemTimer::reset();
+  SubsystemTimer::setEnabled(true);
+  vector<double> turnMillis;
+  auto startTime = steady_clock::now();
+  try {
+    while (turnMillis.size() < numTurns && !game->isTurnBased()) {
+      auto turnStart = steady_clock::now();
+      auto turn = game->getGlobalTime();
+      bool exited = false;
+      while (game->getGlobalTime() == turn && !exited)
+        exited = !!game->update(1);
+      if (exited)
+        break;
+      turnMillis.push_back(duration_cast<microseconds>(steady_clock::now() - turnStart).count() / 1000.0);
+    }
+  } catch (GameExitException) {}
+  double totalMillis = duration_cast<microseconds>(steady_clock::now() - startTime).count() / 1000.0;
+  SubsystemTimer::setEnabled(false);
+  // Serializes without compression, which is measured separately.
+  auto serializeStart = steady_clock::now();
+  size_t serializedBytes = 0;
+  {
+    stringstream stream;
+    OutputArchive archive(stream);
+    archive << game;
+    serializedBytes = stream.tellp();
+  }
+  double serializeMillis = duration_cast<microseconds>(steady_clock::now() - serializeStart).count() / 1000.0;
+  auto sorted = turnMillis;
+  std::sort(sorted.begin(), sorted.end());
+  auto getPercentile = [&](int percent) {
+    return sorted.empty() ? 0.0 : sorted[min<int>(sorted.size() - 1, sorted.size() * percent / 100)];
+  };
+  std::cout << "{\n";
+  std::cout << "  \"save\": \"" << escapeJson(savePath.getPath()) << "\",\n";
+  std::cout << "  \"load_ms\": " << loadMillis << ",\n";
+  std::cout << "  \"serialize_ms\": " << serializeMillis << ",\n";
+  std::cout << "  \"serialized_bytes\": " << serializedBytes << ",\n";
+  std::cout << "  \"turns\": " << turnMillis.size() << ",\n";
+  std::cout << "  \"total_ms\": " << totalMillis << ",\n";
+  std::cout << "  \"turns_per_second\": " << (totalMillis > 0 ? turnMillis.size() * 1000 / totalMillis : 0.0) << ",\n";
+  std::cout << "  \"turn_ms\": {\"p50\": " << getPercentile(50) << ", \"p99\": " << getPercentile(99)
+      << ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << "},\n";
+  // Times of nested subsystems aren't counted twice, e.g. pathfinding is excluded from the monster AI time.
+  std::cout << "  \"subsystem_ms\": {";
+  double otherMillis = totalMillis;
+  for (auto subsystem : ENUM_ALL(Subsystem)) {
+    double millis = duration_cast<microseconds>(SubsystemTimer::getTotal(subsystem)).count() / 1000.0;
+    otherMillis -= millis;
+    std::cout << (subsystem == Subsystem(0) ? "" : ", ") << "\"" << toLower(EnumInfo<Subsystem>::getString(subsystem))
+        << "\": " << millis;
+  }
+  std::cout << ", \"other\": " << max(0.0, otherMillis) << "},\n";
+  // Counted since the save was loaded. Only the fields of view that were looked up are listed.
+  std::cout << "  \"visibility_cache\": [";
+  bool firstStats = true;
+  for (auto model : game->getAllModels())
+    for (auto level : model->getLevels())
+      for (auto vision : ENUM_ALL(VisionId)) {
+        auto& stats = level->getVisibilityCacheStats(vision);
+        if (stats.hits + stats.misses == 0)
+          continue;
+        std::cout << (firstStats ? "\n" : ",\n") << "    {\"level\": " << level->getUniqueId() << ", \"vision\": \""
+            << toLower(EnumInfo<VisionId>::getString(vision)) << "\", \"hits\": " << stats.hits
+            << ", \"misses\": " << stats.misses << ", \"evictions\": " << stats.evictions << ", \"entries\": "
+            << stats.numEntries << ", \"memory_bytes\": " << stats.memoryUsage << "}";
+        firstStats = false;
+      }
+  std::cout << (firstStats ? "],\n" : "\n  ],\n");
+  std::cout << "  \"memory_bytes\": {";
+  size_t totalBytes = 0;
+  for (auto category : ENUM_ALL(MemoryCategory)) {
+    totalBytes += MemoryCounter::getTotal(category);
+    std::cout << (category == MemoryCategory(0) ? "" : ", ") << "\""
+        << toLower(EnumInfo<MemoryCategory>::getString(category)) << "\": " << MemoryCounter::getTotal(category);
+  }
+  std::cout << ", \"total\": " << totalBytes << "}\n";
+  std::cout << "}" << std::endl;
+}
+
+static Table<double> makeBenchmarkDungeon(Rectangle bounds, double rockCost, RandomGen& random) {
+  Table<double> ret(bounds, rockCost);
+  vector<Vec2> rooms;
+  for (int i : Range(bounds.area() / 600)) {
+    Vec2 size(random.get(4, 13), random.get(4, 13));
+    Vec2 pos(random.get(1, bounds.width() - size.x - 1), random.get(1, bounds.height() - size.y - 1));
+    for (Vec2 v : Rectangle(pos, pos + size))
+      ret[v] = 1;
+    rooms.push_back(pos + size / 2);
+  }
+  for (int i : Range(1, rooms.size())) {
+    Vec2 from = rooms[i - 1];
+    Vec2 to = rooms[i];
+    for (int x : Range(min(from.x, to.x), max(from.x, to.x) + 1))
+      ret[Vec2(x, from.y)] = 1;
+    for (int y : Range(min(from.y, to.y), max(from.y, to.y) + 1))
+      ret[Vec2(to.x, y)] = 1;
+  }
+  // Creatures and doors on the way.
+  for (Vec2 v : bounds)
+    if (ret[v] == 1 && random.roll(15))
+      ret[v] = 5;
+  return ret;
+}
+
+void MainLoop::pathfindingMicrobenchmark(int numPaths) {
+  RandomGen random;
+  random.init(0);
+  Rectangle bounds(200, 200);
+  for (double rockCost : {ShortestPath::infinity, 11.0}) {
+    auto costs = makeBenchmarkDungeon(bounds, rockCost, random);
+    auto floor = bounds.getAllSquares().filter([&](Vec2 v) { return costs[v] < ShortestPath::infinity; });
+    vector<pair<Vec2, Vec2>> queries;
+    for (int i : Range(numPaths))
+      queries.push_back(make_pair(random.choose(floor), random.choose(floor)));
+    std::cout << (rockCost < ShortestPath::infinity ? "Digging" : "Walking") << ", " << numPaths << " paths"
+        << std::endl;
+    for (bool useBucketQueue : {false, true}) {
+      ShortestPath::useBucketQueue = useBucketQueue;
+      long long numExpanded = 0;
+      auto time = steady_clock::now();
+      for (auto& query : queries) {
+        Vec2 from = query.first;
+        ShortestPath path(bounds, [&](Vec2 v) { return costs[v]; },
+            [from](Vec2 v) { return 2 * (from.dist8(v) + 0.01 * from.distD(v)); },
+            Vec2::directions8(), query.second, from);
+        numExpanded += path.getNumExpanded();
+      }
+      auto micros = max<long long>(1, duration_cast<microseconds>(steady_clock::now() - time).count());
+      std::cout << (useBucketQueue ? "Bucket queue: " : "Binary heap: ") << numExpanded * 1000000 / micros
+          << " nodes/s, " << micros / numPaths << " us/path" << std::endl;
+    }
+  }
+  ShortestPath::useBucketQueue = true;
+}
+
 optional<string> MainLoop::verifyMod(const string& path) {
   /*auto modsPath = userPath.subdirectory("mods_tmp");
   OnExit ex123([modsPath] { modsPath.removeRecursively(); });
@@ -1114,22 +1466,26 @@ ModelTable MainLoop::prepareCampaignModels(CampaignSetup& setup, const AvatarInf
         EnemyFactory enemyFactory(Random, contentFactory->getCreatures().getNameGenerator(), contentFactory->enemies,
             contentFactory->buildingInfo, contentFactory->externalEnemies);
         ModelBuilder modelBuilder(nullptr, random, options, sokobanInput, contentFactory, std::move(enemyFactory));
+        // Files that are loaded are removed, so each retired site is used only once.
+        vector<pair<FilePath, EnemyId>> retiredSites;
+        for (auto& info : getSaveFiles(userPath, getSaveSuffix(GameSaveType::RETIRED_SITE)))
+          if (isCompatible(getSaveVersion(info)))
+            if (auto saved = saveFileIndex.getSavedGameInfo(userPath.file(info.filename)))
+              if (auto& retiredInfo = saved->retiredEnemyInfo)
+                retiredSites.push_back(make_pair(userPath.file(info.filename), retiredInfo->enemyId));
         for (Vec2 v : sites.getBounds()) {
           if (!sites[v].isEmpty())
             meter.addProgress();
           if (sites[v].getKeeper()) {
             models[v] = getBaseModel(modelBuilder, setup, avatarInfo);
           } else if (auto villain = sites[v].getVillain()) {
-            for (auto& info : getSaveFiles(userPath, getSaveSuffix(GameSaveType::RETIRED_SITE)))
-              if (isCompatible(getSaveVersion(info)))
-                if (auto saved = loadSavedGameInfo(userPath.file(info.filename)))
-                  if (auto& retiredInfo = saved->retiredEnemyInfo)
-                    if (retiredInfo->enemyId == villain->enemyId)
-                      if (auto model = loadFromFile<RetiredModelInfo>(userPath.file(info.filename), !useSingleThread)) {
-                        models[v] = std::move(model->model);
-                        remove(userPath.file(info.filename).getPath());
-                        break;
-                      }
+            for (auto& site : retiredSites)
+              if (site.second == villain->enemyId && site.first.exists())
+                if (auto model = loadFromFile<RetiredModelInfo>(site.first, !useSingleThread)) {
+                  models[v] = std::move(model->model);
+                  remove(site.first.getPath());
+                  break;
+                }
             if (!models[v])
               models[v] = modelBuilder.campaignSiteModel(villain->enemyId, villain->type, avatarInfo.tribeAlignment);
           } else if (auto retired = sites[v].getRetired()) {
@@ -5,6 +5,7 @@
 #include "exit_info.h"
 #include "experience_type.h"
 #include "game_time.h"
+#include "save_file_index.h"
 
 class View;
 class Highscores;
@@ -47,7 +48,13 @@ class MainLoop {
   void campaignBattleText(int numTries, const FilePath& levelPath, EnemyId keeperId, VillainGroup);
   int campaignBattleText(int numTries, const FilePath& levelPath, EnemyId keeperId, EnemyId);
   optional<string> verifyMod(const string& path);
+  void pathfindingBenchmark(const FilePath& savePath, int numPaths);
+  void pathfindingMicrobenchmark(int numPaths);
+  /** Loads a save and runs the given number of turns without rendering. Prints the timings as JSON.*/
+  void turnBenchmark(const FilePath& savePath, int numTurns);
   void launchQuickGame(optional<int> maxTurns);
+  /** If set, autosaves are written by a forked copy of the process on Linux, so the game doesn't stop.*/
+  static bool forkAutosave;
   void playSimpleGame();
 
   private:
@@ -56,6 +63,13 @@ class MainLoop {
   int getSaveVersion(const SaveFileInfo& save);
   void uploadFile(const FilePath& path, const string& title, const SavedGameInfo&);
   void saveUI(PGame&, GameSaveType type);
+  /** Returns false if the forked autosave couldn't be started.*/
+  bool startForkedAutosave(PGame&);
+  /** Returns none while the forked autosave is running, and whether it succeeded once it finished. Waiting gives
+      up after a while, kills the process and reports a failure.*/
+  optional<bool> pollForkedAutosave(bool wait);
+  optional<int> autosaveProcess;
+  optional<FilePath> autosaveTmpPath;
   void getSaveOptions(const vector<pair<GameSaveType, string>>&,
       vector<ListElem>& options, vector<SaveFileInfo>& allFiles);
 
@@ -100,13 +114,16 @@ class MainLoop {
   TileSet* tileSet;
   int saveVersion;
   string modVersion;
+  SaveFileIndex saveFileIndex;
   PModel getBaseModel(ModelBuilder&, CampaignSetup&, const AvatarInfo&);
   void considerGameEventsPrompt();
   void considerFreeVersionText(bool tilesPresent);
   void eraseAllSavesExcept(const PGame&, optional<GameSaveType>);
   PGame prepareTutorial(const ContentFactory*);
   void bugReportSave(PGame&, FilePath);
-  void saveGame(PGame&, const FilePath&);
+  /** If the previous save is given, unchanged chunks are copied from it instead of being compressed again.
+      Returns false if the file couldn't be written.*/
+  bool saveGame(PGame&, const FilePath&, optional<FilePath> previous = none);
   void saveMainModel(PGame&, const FilePath&);
   ContentFactory createContentFactory(bool vanillaOnly) const;
   TilePaths getTilePathsForAllMods() const;
@@ -20,9 +20,18 @@
 #include "view_object.h"
 #include "view_index.h"
 
-SERIALIZE_DEF(MapMemory, table)
+template <class Archive>
+void MapMemory::serialize(Archive& ar, const unsigned int) {
+  ar(table);
+  if (Archive::is_loading::value)
+    table->setMemoryCategory(MemoryCategory::MAP_MEMORY);
+}
+
+SERIALIZABLE(MapMemory);
 
-MapMemory::MapMemory() {}
+MapMemory::MapMemory() {
+  table->setMemoryCategory(MemoryCategory::MAP_MEMORY);
+}
 
 void MapMemory::addObject(Position pos, const ViewObject& obj) {
   CHECK(pos.isValid());
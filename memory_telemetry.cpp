@@ -0,0 +1,40 @@
+#include "stdafx.h"
+#include "memory_telemetry.h"
+
+static atomic<long long> totals[EnumInfo<MemoryCategory>::size];
+
+MemoryCounter::MemoryCounter(MemoryCategory c) : category(c) {
+}
+
+MemoryCounter::MemoryCounter(const MemoryCounter& o) : category(o.category) {
+  set(o.bytes);
+}
+
+MemoryCounter& MemoryCounter::operator = (const MemoryCounter& o) {
+  set(o.bytes);
+  return *this;
+}
+
+MemoryCounter::~MemoryCounter() {
+  set(0);
+}
+
+void MemoryCounter::set(size_t b) {
+  totals[int(category)] += (long long) b - (long long) bytes;
+  bytes = b;
+}
+
+void MemoryCounter::setCategory(MemoryCategory c) {
+  auto b = bytes;
+  set(0);
+  category = c;
+  set(b);
+}
+
+size_t MemoryCounter::get() const {
+  return bytes;
+}
+
+size_t MemoryCounter::getTotal(MemoryCategory category) {
+  return max(0LL, totals[int(category)].load());
+}
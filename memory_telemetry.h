@@ -0,0 +1,35 @@
+#pragma once
+
+#include "util.h"
+
+RICH_ENUM(MemoryCategory,
+  FIELD_OF_VIEW,
+  MAP_MEMORY,
+  SECTORS,
+  POSITION_MAPS,
+  TASK_MAPS,
+  INVENTORIES,
+  FX,
+  TEXTURES
+);
+
+/** Bytes held by one object of a subsystem. The owner keeps it as a member and updates it when it grows
+    or shrinks, so the totals of all categories are always current and can be read from any thread.
+    The sizes are estimates of the main buffers, not exact heap usage.*/
+class MemoryCounter {
+  public:
+  MemoryCounter(MemoryCategory);
+  MemoryCounter(const MemoryCounter&);
+  MemoryCounter& operator = (const MemoryCounter&);
+  ~MemoryCounter();
+
+  void set(size_t bytes);
+  size_t get() const;
+  void setCategory(MemoryCategory);
+
+  static size_t getTotal(MemoryCategory);
+
+  private:
+  MemoryCategory category;
+  size_t bytes = 0;
+};
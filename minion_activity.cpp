@@ -32,7 +32,7 @@ static bool betterPos(Position from, Position current, Position candidate) {
 static optional<Position> getTileToExplore(Collective* collective, const Creature* c, MinionActivity task) {
   auto& borderTiles = collective->getKnownTiles().getBorderTiles();
   auto blockName = "get tile to explore " + toString(borderTiles.size());
-  PROFILE_BLOCK(blockName.data());
+  PROFILE_BLOCK(blockName);
   auto movementType = c->getMovementType();
   optional<Position> caveTile;
   optional<Position> outdoorTile;
@@ -55,6 +55,7 @@
 #include "unknown_locations.h"
 #include "avatar_info.h"
 #include "collective_config.h"
+#include "subsystem_timer.h"
 
 template <class Archive> 
 void Model::serialize(Archive& ar, const unsigned int version) {
@@ -62,6 +63,10 @@ void Model::serialize(Archive& ar, const unsigned int version) {
   ar & SUBCLASS(OwnedObject<Model>);
   ar(levels, collectives, timeQueue, deadCreatures, currentTime, woodCount, game, lastTick);
   ar(stairNavigation, cemetery, mainLevels, eventGenerator, externalEnemies, defaultMusic);
+  if (version >= 1)
+    ar(random);
+  else if (Archive::is_loading::value)
+    random.init(Random.get(1000000000));
 }
 
 SERIALIZATION_CONSTRUCTOR_IMPL(Model)
@@ -118,6 +123,7 @@ void Model::checkCreatureConsistency() {
 }
 
 bool Model::update(double totalTime) {
+  RandomGen::Redirect redirect(random);
   currentTime = totalTime;
   if (Creature* creature = timeQueue->getNextCreature(totalTime)) {
     CHECK(creature->getLevel() != nullptr) << "Creature misplaced before processing: " << creature->getName().bare() <<
@@ -134,6 +140,8 @@ bool Model::update(double totalTime) {
         ". Any idea why this happened?";
     if (!creature->isDead()) {
       INFO << "Turn " << totalTime << " " << creature->getName().bare() << " moving now";
+      // Vision checks during the move must see the light sources that moved before it.
+      creature->getLevel()->flushLightChanges();
       creature->makeMove();
     }
     CHECK(creature->getLevel() != nullptr) << "Creature misplaced after moving: " << creature->getName().bare() <<
@@ -146,6 +154,7 @@ bool Model::update(double totalTime) {
 }
 
 void Model::tick(LocalTime time) { PROFILE
+  SubsystemTimer timer(Subsystem::MODEL_TICK);
   for (Creature* c : timeQueue->getAllCreatures()) {
     c->tick();
   }
@@ -157,6 +166,10 @@ void Model::tick(LocalTime time) { PROFILE
     externalEnemies->update(getTopLevel(), time);
 }
 
+RandomGen& Model::getRandom() {
+  return random;
+}
+
 void Model::addCreature(PCreature c) {
   addCreature(std::move(c), 1_visible);// + Random.getDouble());
 }
@@ -354,6 +367,7 @@ const heap_optional<ExternalEnemies>& Model::getExternalEnemies() const {
 
 void Model::addEvent(const GameEvent& e) {
   PROFILE;
+  SubsystemTimer timer(Subsystem::EVENTS);
   eventGenerator->addEvent(e);
 }
 
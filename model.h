@@ -101,6 +101,9 @@ class Model : public OwnedObject<Model> {
 
   void addEvent(const GameEvent&);
 
+  /** Random stream used by everything that happens inside this model.*/
+  RandomGen& getRandom();
+
   WLevel buildLevel(LevelBuilder, PLevelMaker, int depth, optional<string> name);
   WLevel buildMainLevel(LevelBuilder, PLevelMaker);
   void calculateStairNavigation();
@@ -138,5 +141,8 @@ class Model : public OwnedObject<Model> {
   heap_optional<ExternalEnemies> SERIAL(externalEnemies);
   int moveCounter = 0;
   optional<MusicType> SERIAL(defaultMusic);
+  RandomGen SERIAL(random);
 };
 
+CEREAL_CLASS_VERSION(Model, 1)
+
@@ -55,6 +55,7 @@
 #include "effect_type.h"
 #include "health_type.h"
 #include "automaton_part.h"
+#include "subsystem_timer.h"
 
 class Behaviour {
   public:
@@ -1341,6 +1342,7 @@ MonsterAI::MonsterAI(Creature* c, const vector<Behaviour*>& beh, const vector<in
 
 void MonsterAI::makeMove() {
   PROFILE;
+  SubsystemTimer timer(Subsystem::MONSTER_AI);
   vector<MoveInfo> moves;
   for (int i : All(behaviours)) {
     MoveInfo move = behaviours[i]->getMove();
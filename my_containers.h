@@ -428,9 +428,12 @@ class vector {
   int modCounter = 0;
 };
 
+template <class Archive, typename T>
+void serializeVector(Archive&, std::vector<T>&);
+
 template <class Archive, typename T>
 inline void serialize(Archive& ar1, vector<T>& v) {
-  ar1(v.impl);
+  serializeVector(ar1, v.impl);
 }
 
 
@@ -0,0 +1,17 @@
+#include "stdafx.h"
+#include "navigation_cost_grid.h"
+
+const double NavigationCostGrid::infinity = 1000000000;
+
+NavigationCostGrid::NavigationCostGrid(Rectangle bounds) : costs(bounds, impassable) {
+}
+
+bool NavigationCostGrid::set(Vec2 v, double cost) {
+  auto previous = costs[v];
+  if (cost >= infinity)
+    costs[v] = impassable;
+  else
+    // Very strong furniture saturates just below impassable.
+    costs[v] = (uint16_t) max(1, min<int>(impassable - 1, std::lround(cost * resolution)));
+  return costs[v] != previous;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "util.h"
+
+/** Compact table of the navigation costs of a level for one movement type. Costs are stored in fixed point
+    and kept up to date by the level together with its sectors, so path searches read a flat array instead
+    of inspecting the squares. The penalty for tiles occupied by creatures is not included.*/
+class NavigationCostGrid {
+  public:
+  NavigationCostGrid(Rectangle bounds);
+
+  /** Returns true if the stored cost changed.*/
+  bool set(Vec2, double cost);
+
+  double get(Vec2 v) const {
+    auto value = costs[v];
+    return value == impassable ? infinity : double(value) / resolution;
+  }
+
+  /** Returns true if the tile can be entered without destroying anything or building a bridge.*/
+  bool isFreeMovement(Vec2 v) const {
+    return costs[v] == resolution;
+  }
+
+  static const double infinity;
+
+  private:
+  static constexpr int resolution = 16;
+  static constexpr uint16_t impassable = 0xffff;
+  Table<uint16_t> costs;
+};
@@ -2,44 +2,67 @@
 
 #include "util.h"
 #include "saved_game_info.h"
-#include "gzstream.h"
+#include "compressed_stream.h"
 #include "file_path.h"
 
-typedef StreamCombiner<ogzstream, OutputArchive> CompressedOutput;
-typedef StreamCombiner<igzstream, InputArchive> CompressedInput;
+typedef StreamCombiner<CompressedOutputStream, OutputArchive> CompressedOutput;
+typedef StreamCombiner<CompressedInputStream, InputArchive> CompressedInput;
 
-template <typename InputType>
-optional<pair<string, int>> getNameAndVersionUsing(const FilePath& filename) {
-  try {
-    InputType input(filename.getPath());
-    pair<string, int> ret;
-    input.getArchive() >> ret.second >> ret.first;
-    return ret;
-  } catch (std::exception&) {
-    return none;
+/** Serializes the version, name and info that start every save, so they can also be stored in the uncompressed
+    header of the file.*/
+inline string getSaveHeader(int version, const string& name, const SavedGameInfo& info) {
+  stringstream ss;
+  {
+    OutputArchive archive(ss);
+    archive << version << name << info;
   }
+  return ss.str();
 }
 
-inline optional<pair<string, int>> getNameAndVersion(const FilePath& filename) {
-  return getNameAndVersionUsing<CompressedInput>(filename);
+inline pair<string, int> readNameAndVersion(InputArchive& archive) {
+  pair<string, int> ret;
+  archive >> ret.second >> ret.first;
+  return ret;
 }
 
-template <typename InputType>
-optional<SavedGameInfo> getSavedGameInfoUsing(const FilePath& filename) {
+inline SavedGameInfo readSavedGameInfo(InputArchive& archive) {
+  string discard2;
+  int discard;
+  SavedGameInfo ret;
+  archive >> discard >> discard2 >> ret;
+  return ret;
+}
+
+/** Calls the function with an archive reading the serialized header.*/
+template <typename Fun>
+auto readSaveHeader(const string& header, Fun fun) -> optional<decltype(fun(std::declval<InputArchive&>()))> {
   try {
-    InputType input(filename.getPath());
-    string discard2;
-    int discard;
-    SavedGameInfo ret;
-    input.getArchive() >> discard >> discard2 >> ret;
-    return ret;
+    stringstream ss(header);
+    InputArchive archive(ss);
+    return fun(archive);
   } catch (std::exception&) {
     return none;
   }
 }
 
-inline optional<SavedGameInfo> loadSavedGameInfo(const FilePath& filename) {
-  return getSavedGameInfoUsing<CompressedInput>(filename);
+/** Calls the function with an archive positioned at the start of the save. The uncompressed header is used if the
+    file has one, otherwise the beginning of the file is decompressed.*/
+template <typename Fun>
+auto readSaveHeader(const FilePath& filename, Fun fun) -> optional<decltype(fun(std::declval<InputArchive&>()))> {
+  if (auto header = readCompressedFileHeader(filename.getPath()))
+    return readSaveHeader(*header, fun);
+  try {
+    CompressedInput input(filename.getPath());
+    return fun(input.getArchive());
+  } catch (std::exception&) {
+    return none;
+  }
 }
 
+inline optional<pair<string, int>> getNameAndVersion(const FilePath& filename) {
+  return readSaveHeader(filename, readNameAndVersion);
+}
 
+inline optional<SavedGameInfo> loadSavedGameInfo(const FilePath& filename) {
+  return readSaveHeader(filename, readSavedGameInfo);
+}
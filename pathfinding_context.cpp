@@ -0,0 +1,36 @@
+#include "stdafx.h"
+#include "pathfinding_context.h"
+#include "level.h"
+
+const double DistanceTable::infinity = 1000000000;
+
+DistanceTable::DistanceTable(Rectangle bounds) : ddist(bounds), dirty(bounds, 0) {
+}
+
+void BucketQueue::clear() {
+  for (int i = current; i <= maxUsed; ++i)
+    buckets[i].clear();
+  if (buckets.size() > maxRetainedBuckets) {
+    buckets.resize(maxRetainedBuckets);
+    buckets.shrink_to_fit();
+  }
+  overflow.clear();
+  current = maxBucket;
+  maxUsed = -1;
+  size = 0;
+}
+
+void HeapQueue::clear() {
+  q = decltype(q)();
+}
+
+PathfindingContext::PathfindingContext() : distanceTable(Level::getMaxBounds()),
+    navigationCostCache(Level::getMaxBounds(), 0), bfsTable(Level::getMaxBounds(), -1) {
+}
+
+PathfindingContext& PathfindingContext::forThisThread() {
+  static thread_local unique_ptr<PathfindingContext> context;
+  if (!context)
+    context = unique<PathfindingContext>();
+  return *context;
+}
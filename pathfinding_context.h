@@ -0,0 +1,136 @@
+#pragma once
+
+#include "util.h"
+
+class DistanceTable {
+  public:
+  DistanceTable(Rectangle bounds);
+
+  double getDistance(Vec2 v) const {
+    return dirty[v] < counter ? infinity : ddist[v];
+  }
+
+  void setDistance(Vec2 v, double d) {
+    ddist[v] = d;
+    dirty[v] = counter;
+  }
+
+  void clear() {
+    ++counter;
+  }
+
+  static const double infinity;
+
+  private:
+  Table<double> ddist;
+  Table<int> dirty;
+  int counter = 1;
+};
+
+/** Binary heap with the same interface as BucketQueue. It keeps the exact order of the keys.*/
+class HeapQueue {
+  public:
+  void push(double key, Vec2 pos) {
+    q.push(Elem{pos, key});
+  }
+
+  bool empty() const {
+    return q.empty();
+  }
+
+  Vec2 top() const {
+    return q.top().pos;
+  }
+
+  double getTopKey() const {
+    return q.top().value;
+  }
+
+  void pop() {
+    q.pop();
+  }
+
+  void clear();
+
+  private:
+  struct Elem {
+    Vec2 pos;
+    double value;
+    bool operator < (const Elem& o) const {
+      return value > o.value || (value == o.value && pos < o.pos);
+    }
+  };
+  priority_queue<Elem, vector<Elem>> q;
+};
+
+/** Monotone-friendly priority queue with keys rounded to fixed point. Elements with equal rounded keys
+    come out in LIFO order. Pushing a key lower than the last popped one is allowed. Keys beyond the range of the
+    buckets go to a binary heap, which is only popped once the buckets are empty.*/
+class BucketQueue {
+  public:
+  void push(double key, Vec2 pos) {
+    if (key * resolution >= maxBucket) {
+      overflow.push(key, pos);
+      return;
+    }
+    int index = max(0, int(key * resolution));
+    if (index >= buckets.size())
+      buckets.resize(index + 1);
+    buckets[index].push_back(pos);
+    current = min(current, index);
+    maxUsed = max(maxUsed, index);
+    ++size;
+  }
+
+  bool empty() const {
+    return size == 0 && overflow.empty();
+  }
+
+  Vec2 top() {
+    if (size == 0)
+      return overflow.top();
+    while (buckets[current].empty())
+      ++current;
+    return buckets[current].back();
+  }
+
+  void pop() {
+    if (size == 0) {
+      overflow.pop();
+      return;
+    }
+    top();
+    buckets[current].pop_back();
+    --size;
+  }
+
+  void clear();
+
+  private:
+  static constexpr double resolution = 16;
+  static constexpr int maxBucket = 1 << 16;
+  // Buckets beyond this many are freed after a query.
+  static constexpr int maxRetainedBuckets = 1 << 12;
+  vector<vector<Vec2>> buckets;
+  HeapQueue overflow;
+  int current = maxBucket;
+  int maxUsed = -1;
+  int size = 0;
+};
+
+/** Scratch memory used by path queries. A context can only serve one query at a time, so every thread
+    gets its own.*/
+class PathfindingContext {
+  public:
+  PathfindingContext();
+  PathfindingContext(const PathfindingContext&) = delete;
+
+  static PathfindingContext& forThisThread();
+
+  DistanceTable distanceTable;
+  DirtyTable<double> navigationCostCache;
+  DirtyTable<int> bfsTable;
+  BucketQueue bucketQueue;
+  HeapQueue heapQueue;
+  bool logging = true;
+};
@@ -38,8 +38,8 @@ void Portals::recalculateDistances(WLevel level) {
       return 10000;
   };
   Dijkstra dijkstra(distanceToNearest.getBounds(), portals, 10000, entryFun);
-  for (auto& pos : dijkstra.getAllReachable())
-    distanceToNearest[pos.first] = (short) pos.second;
+  for (Vec2 pos : dijkstra.getAllReachable())
+    distanceToNearest[pos] = (short) dijkstra.getDist(pos);
 }
 
 Portals::Portals(Rectangle bounds) : distanceToNearest(bounds) {
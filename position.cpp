@@ -203,17 +203,29 @@ optional<Position> Position::getOtherPortal() const {
 void Position::registerPortal() {
   if (isValid()) {
     level->portals->registerPortal(*this);
-    if (auto other = level->portals->getOtherPortal(coord))
+    if (auto other = level->portals->getOtherPortal(coord)) {
       for (auto& sectors : level->sectors)
         sectors.second.addExtraConnection(coord, *other);
+      for (auto& graph : level->clusterGraphs) {
+        graph.second.invalidate(coord);
+        graph.second.invalidate(*other);
+      }
+      level->flowFields.clear();
+    }
   }
 }
 
 void Position::removePortal() {
   if (isValid()) {
-    if (auto other = level->portals->getOtherPortal(coord))
+    if (auto other = level->portals->getOtherPortal(coord)) {
       for (auto& sectors : level->sectors)
         sectors.second.removeExtraConnection(coord, *other);
+      for (auto& graph : level->clusterGraphs) {
+        graph.second.invalidate(coord);
+        graph.second.invalidate(*other);
+      }
+      level->flowFields.clear();
+    }
     level->portals->removePortal(*this);
   }
 }
@@ -976,11 +988,18 @@ void Position::updateConnectivity() const {
   auto movementEventPredicate = [this] { return level->getSectorsDontCreate({MovementTrait::WALK}).contains(coord); };
   bool couldEnter = movementEventPredicate();
   if (isValid()) {
-    for (auto& elem : level->sectors)
-      if (canNavigateCalc(elem.first))
+    for (auto& elem : level->sectors) {
+      bool canNavigate = canNavigateCalc(elem.first);
+      if (canNavigate != elem.second.contains(coord))
+        level->flowFields.clear(elem.first);
+      if (canNavigate)
         elem.second.add(coord);
       else
         elem.second.remove(coord);
+    }
+    for (auto& elem : level->clusterGraphs)
+      elem.second.invalidate(coord);
+    level->updateNavigationCosts(coord);
   }
   if (couldEnter != movementEventPredicate())
     if (auto game = getGame())
@@ -1080,6 +1099,11 @@ double Position::getNavigationCost(const MovementType& movement, const Sectors&
   return ShortestPath::infinity;
 }
 
+void Position::updateNavigationCost() const {
+  if (isValid())
+    level->updateNavigationCosts(coord);
+}
+
 bool Position::canNavigate(const MovementType& type) const {
   PROFILE;
   return isValid() && level->getSectors(type).contains(coord);
@@ -121,6 +121,7 @@ class Position {
   bool canNavigateToOrNeighbor(Position, const MovementType&) const;
   bool canNavigateTo(Position, const MovementType&) const;
   double getNavigationCost(const MovementType&, const Sectors& onltMovementSectors) const;
+  void updateNavigationCost() const;
   optional<DestroyAction> getBestDestroyAction(const MovementType&) const;
   vector<Position> getVisibleTiles(const Vision&);
   void updateConnectivity() const;
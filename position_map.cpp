@@ -74,23 +74,44 @@ Table<heap_optional<T>>& PositionMap<T>::getTable(Position pos) {
     return tables.at(levelId);
   } catch (std::out_of_range) {
     auto it = tables.insert(make_pair(levelId, Table<heap_optional<T>>(pos.getLevel()->getBounds().minusMargin(-2))));
+    updateMemoryCounter();
     return it.first->second;
   }
 }
 
+template <class T>
+void PositionMap<T>::updateMemoryCounter() {
+  size_t bytes = 0;
+  for (auto& elem : tables)
+    bytes += elem.second.getBounds().area() * sizeof(heap_optional<T>);
+  for (auto& elem : outliers)
+    bytes += elem.second.size() * (sizeof(Vec2) + sizeof(T));
+  memoryCounter.set(bytes + numElements * sizeof(T));
+}
+
+template <class T>
+void PositionMap<T>::setMemoryCategory(MemoryCategory category) {
+  memoryCounter.setCategory(category);
+}
+
 template <class T>
 T& PositionMap<T>::getOrInit(Position pos) {
   LevelId levelId = pos.getLevel()->getUniqueId();
   auto& table = getTable(pos);
   if (pos.getCoord().inRectangle(table.getBounds())) {
-    if (!table[pos.getCoord()])
+    if (!table[pos.getCoord()]) {
       table[pos.getCoord()] = T();
+      ++numElements;
+      updateMemoryCounter();
+    }
     return *table[pos.getCoord()];
   }
   else try {
     return outliers.at(levelId).at(pos.getCoord());
   } catch (std::out_of_range) {
-    return outliers[levelId][pos.getCoord()] = T();
+    auto& ret = outliers[levelId][pos.getCoord()] = T();
+    updateMemoryCounter();
+    return ret;
   }
 }
 
@@ -130,18 +151,27 @@ template <class T>
 void PositionMap<T>::set(Position pos, const T& elem) {
   LevelId levelId = pos.getLevel()->getUniqueId();
   auto& table = getTable(pos);
-  if (pos.getCoord().inRectangle(table.getBounds()))
+  if (pos.getCoord().inRectangle(table.getBounds())) {
+    if (!table[pos.getCoord()]) {
+      ++numElements;
+      updateMemoryCounter();
+    }
     table[pos.getCoord()] = elem;
-  else
+  } else {
     outliers[levelId][pos.getCoord()] = elem;
+    updateMemoryCounter();
+  }
 }
 
 template<class T>
 void PositionMap<T>::erase(Position pos) {
   LevelId levelId = pos.getLevel()->getUniqueId();
   if (auto table = ::getReferenceMaybe(tables, levelId))
-    if (pos.getCoord().inRectangle(table->getBounds()))
+    if (pos.getCoord().inRectangle(table->getBounds()) && (*table)[pos.getCoord()]) {
       (*table)[pos.getCoord()] = none;
+      --numElements;
+      updateMemoryCounter();
+    }
   if (auto out = ::getReferenceMaybe(outliers, levelId))
     if (auto elem = ::getReferenceMaybe(*out, pos.getCoord()))
       elem = none;
@@ -156,15 +186,30 @@ void PositionMap<T>::limitToModel(const WModel m) {
   for (auto& elem : copyOf(tables))
     if (!goodIds.count(elem.first))
       tables.erase(elem.first);
+  countElements();
   for (auto& elem : copyOf(outliers))
     if (!goodIds.count(elem.first))
       outliers.erase(elem.first);
+  updateMemoryCounter();
 }
 
 template <class T>
 template <class Archive> 
 void PositionMap<T>::serialize(Archive& ar, const unsigned int version) {
   ar(tables, outliers);
+  if (Archive::is_loading::value) {
+    countElements();
+    updateMemoryCounter();
+  }
+}
+
+template <class T>
+void PositionMap<T>::countElements() {
+  numElements = 0;
+  for (auto& elem : tables)
+    for (Vec2 v : elem.second.getBounds())
+      if (elem.second[v])
+        ++numElements;
 }
 
 template <class T>
@@ -2,6 +2,7 @@
 
 #include "util.h"
 #include "position.h"
+#include "memory_telemetry.h"
 
 class Level;
 
@@ -18,12 +19,18 @@ class PositionMap {
   void set(Position, const T&);
   void erase(Position);
   void limitToModel(const WModel);
+  /** Makes the memory of this map count towards another category.*/
+  void setMemoryCategory(MemoryCategory);
 
   SERIALIZATION_DECL(PositionMap)
 
   private:
   Table<heap_optional<T> >& getTable(Position);
+  void updateMemoryCounter();
+  void countElements();
   map<LevelId, Table<heap_optional<T>>> SERIAL(tables);
   map<LevelId, map<Vec2, T>> SERIAL(outliers);
+  int numElements = 0;
+  MemoryCounter memoryCounter {MemoryCategory::POSITION_MAPS};
 };
 
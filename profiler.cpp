@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include "util.h"
+#include <iomanip>
+
+namespace {
+
+struct Event {
+  const char* name;
+  long long begin;
+  long long end;
+};
+
+// Only the owning thread writes to a buffer. The export copies the events and then drops the ones that might
+// have been overwritten in the meantime.
+struct EventBuffer {
+  static constexpr int capacity = 1 << 16;
+  vector<Event> events = vector<Event>(capacity);
+  atomic<unsigned long long> numWritten {0};
+  unordered_set<string> names;
+  int threadIndex = 0;
+};
+
+struct BufferRegistry {
+  std::mutex lock;
+  vector<unique_ptr<EventBuffer>> buffers;
+  vector<EventBuffer*> unused;
+  int numThreads = 0;
+};
+
+BufferRegistry& getRegistry() {
+  static BufferRegistry registry;
+  return registry;
+}
+
+// Threads like the pathfinding workers come and go, so their buffers are reused instead of piling up.
+struct ThreadBuffer {
+  EventBuffer* buffer = nullptr;
+
+  EventBuffer& get() {
+    if (!buffer) {
+      auto& registry = getRegistry();
+      std::lock_guard<std::mutex> guard(registry.lock);
+      if (!registry.unused.empty()) {
+        buffer = registry.unused.back();
+        registry.unused.pop_back();
+      } else {
+        registry.buffers.push_back(unique<EventBuffer>());
+        buffer = registry.buffers.back().get();
+      }
+      buffer->threadIndex = registry.numThreads++;
+    }
+    return *buffer;
+  }
+
+  ~ThreadBuffer() {
+    if (buffer) {
+      auto& registry = getRegistry();
+      std::lock_guard<std::mutex> guard(registry.lock);
+      registry.unused.push_back(buffer);
+    }
+  }
+};
+
+thread_local ThreadBuffer threadBuffer;
+
+const auto startTime = steady_clock::now();
+
+}
+
+atomic<bool> Profiler::enabled(false);
+
+void Profiler::setEnabled(bool e) {
+  enabled = e;
+}
+
+long long Profiler::getTimestamp() {
+  // Zero is reserved for scopes that aren't recorded.
+  return duration_cast<nanoseconds>(steady_clock::now() - startTime).count() + 1;
+}
+
+void Profiler::record(const char* name, long long begin, long long end) {
+  auto& buffer = threadBuffer.get();
+  auto index = buffer.numWritten.load(std::memory_order_relaxed);
+  buffer.events[index % EventBuffer::capacity] = Event{name, begin, end};
+  buffer.numWritten.store(index + 1, std::memory_order_release);
+}
+
+const char* Profiler::internName(const string& name) {
+  return threadBuffer.get().names.insert(name).first->c_str();
+}
+
+static string escapeName(const char* name) {
+  string ret;
+  for (; *name; ++name) {
+    if (*name == '"' || *name == '\\')
+      ret += '\\';
+    if (*name >= 0 && *name < 32)
+      ret += ' ';
+    else
+      ret += *name;
+  }
+  return ret;
+}
+
+void Profiler::exportChromeTrace(const string& path) {
+  std::ofstream out(path);
+  // Timestamps are in microseconds.
+  out << std::fixed << std::setprecision(3);
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  auto& registry = getRegistry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  for (auto& buffer : registry.buffers) {
+    auto numWritten = buffer->numWritten.load(std::memory_order_acquire);
+    auto numCopied = min<unsigned long long>(numWritten, EventBuffer::capacity);
+    vector<Event> events;
+    for (auto i = numWritten - numCopied; i < numWritten; ++i)
+      events.push_back(buffer->events[i % EventBuffer::capacity]);
+    auto numOverwritten = buffer->numWritten.load(std::memory_order_acquire) - numWritten;
+    // Once the buffer is full, the first copied slot is also the one the thread writes next, so it may be torn
+    // even if nothing was published during the copy.
+    auto numSkipped = numOverwritten + (numWritten >= EventBuffer::capacity ? 1 : 0);
+    for (int i = int(min<unsigned long long>(numSkipped, events.size())); i < events.size(); ++i) {
+      auto& event = events[i];
+      out << (first ? "\n" : ",\n");
+      first = false;
+      out << "{\"name\":\"" << escapeName(event.name) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+          << buffer->threadIndex << ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":"
+          << (event.end - event.begin) / 1000.0 << "}";
+    }
+  }
+  out << "\n]}\n";
+}
@@ -1,13 +1,27 @@
 #pragma once
 
+#include <atomic>
+#include <string>
+#include <cstddef>
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
 #ifdef EASY_PROFILER
 #define BUILD_WITH_EASY_PROFILER
 
 #include <easy/profiler.h>
 
+inline const char* getProfileName(const char* name) {
+  return name;
+}
+
+inline const char* getProfileName(const std::string& name) {
+  return name.c_str();
+}
 
 #define PROFILE EASY_FUNCTION(__LINE__)
-#define PROFILE_BLOCK(...) EASY_BLOCK(__VA_ARGS__)
+#define PROFILE_BLOCK(name) EASY_BLOCK(getProfileName(name))
 
 #define ENABLE_PROFILER\
   EASY_PROFILER_ENABLE\
@@ -15,8 +29,52 @@
 
 #else
 
-#define PROFILE
-#define PROFILE_BLOCK(...)
+#define PROFILE ProfileScope PROFILE_CONCAT(profileScope, __COUNTER__)(__PRETTY_FUNCTION__);
+#define PROFILE_BLOCK(name) ProfileScope PROFILE_CONCAT(profileScope, __COUNTER__)(name);
 #define ENABLE_PROFILER
 
 #endif
+
+/** Records the PROFILE and PROFILE_BLOCK scopes into a ring buffer per thread, so only the most recent
+    events are kept. Recording is off by default and costs a single flag check per scope then.*/
+class Profiler {
+  public:
+  static void setEnabled(bool);
+  static bool isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+  }
+  static long long getTimestamp();
+  static void record(const char* name, long long begin, long long end);
+  /** Returns the name with a lifetime long enough for recording.*/
+  static const char* internName(const std::string&);
+  /** Writes the recorded events in the Chrome trace event format, which can be opened in chrome://tracing.*/
+  static void exportChromeTrace(const std::string& path);
+
+  private:
+  static std::atomic<bool> enabled;
+};
+
+class ProfileScope {
+  public:
+  /** String literals and function names are recorded without copying.*/
+  template <std::size_t N>
+  ProfileScope(const char (&n)[N]) : name(n), begin(Profiler::isEnabled() ? Profiler::getTimestamp() : 0) {}
+
+  ProfileScope(const std::string& n) : name(nullptr), begin(0) {
+    if (Profiler::isEnabled()) {
+      name = Profiler::internName(n);
+      begin = Profiler::getTimestamp();
+    }
+  }
+
+  ~ProfileScope() {
+    if (begin > 0)
+      Profiler::record(name, begin, Profiler::getTimestamp());
+  }
+
+  ProfileScope(const ProfileScope&) = delete;
+
+  private:
+  const char* name;
+  long long begin;
+};
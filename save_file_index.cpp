@@ -0,0 +1,92 @@
+#include "stdafx.h"
+#include "save_file_index.h"
+#include "parse_game.h"
+
+// Increased when the format of the index changes, so an old one is discarded.
+static const int indexVersion = 1;
+
+SaveFileIndex::SaveFileIndex(FilePath f) : indexFile(f) {
+}
+
+SaveFileIndex::~SaveFileIndex() {
+  save();
+}
+
+void SaveFileIndex::load() {
+  loaded = true;
+  try {
+    std::ifstream in(indexFile.getPath(), std::ios::binary);
+    if (!in)
+      return;
+    InputArchive archive(in);
+    int version;
+    archive(version);
+    if (version == indexVersion)
+      archive(entries);
+  } catch (std::exception&) {
+    entries.clear();
+  }
+}
+
+void SaveFileIndex::save() {
+  if (!changed)
+    return;
+  changed = false;
+  for (auto it = entries.begin(); it != entries.end();)
+    if (!FilePath::fromFullPath(it->first).exists())
+      it = entries.erase(it);
+    else
+      ++it;
+  std::ofstream out(indexFile.getPath(), std::ios::binary);
+  OutputArchive archive(out);
+  archive(indexVersion, entries);
+}
+
+SaveFileIndex::Entry& SaveFileIndex::getEntry(const FilePath& file) {
+  if (!loaded)
+    load();
+  auto modified = file.getModificationTime();
+  auto size = file.getSize();
+  auto& entry = entries[file.getPath()];
+  if (entry.modified != modified || entry.size != size || size < 0) {
+    entry.modified = modified;
+    entry.size = size;
+    entry.withInfo = false;
+    if ((entry.header = readCompressedFileHeader(file.getPath())))
+      entry.withInfo = true;
+    else if (auto info = ::getNameAndVersion(file)) {
+      stringstream ss;
+      {
+        OutputArchive archive(ss);
+        archive << info->second << info->first;
+      }
+      entry.header = ss.str();
+    }
+    changed = true;
+  }
+  return entry;
+}
+
+optional<pair<string, int>> SaveFileIndex::getNameAndVersion(const FilePath& file) {
+  auto& entry = getEntry(file);
+  if (!entry.header)
+    return none;
+  return readSaveHeader(*entry.header, readNameAndVersion);
+}
+
+optional<SavedGameInfo> SaveFileIndex::getSavedGameInfo(const FilePath& file) {
+  auto& entry = getEntry(file);
+  if (!entry.header)
+    return none;
+  if (!entry.withInfo) {
+    auto nameAndVersion = getNameAndVersion(file);
+    auto info = loadSavedGameInfo(file);
+    if (nameAndVersion && info) {
+      entry.header = getSaveHeader(nameAndVersion->second, nameAndVersion->first, *info);
+      entry.withInfo = true;
+      changed = true;
+    }
+    return info;
+  }
+  return readSaveHeader(*entry.header, readSavedGameInfo);
+}
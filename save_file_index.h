@@ -0,0 +1,37 @@
+#pragma once
+
+#include "util.h"
+#include "file_path.h"
+
+struct SavedGameInfo;
+
+/** Remembers the headers of save files, so the save menus don't read every file again. An entry is reused as long
+    as the modification time and size of its file stay the same. The index is kept in a file between runs.*/
+class SaveFileIndex {
+  public:
+  SaveFileIndex(FilePath indexFile);
+  ~SaveFileIndex();
+
+  optional<pair<string, int>> getNameAndVersion(const FilePath&);
+  optional<SavedGameInfo> getSavedGameInfo(const FilePath&);
+
+  /** Writes the index if anything changed, dropping the files that no longer exist.*/
+  void save();
+
+  private:
+  struct Entry {
+    time_t SERIAL(modified) = 0;
+    long long SERIAL(size) = -1;
+    // None if the file couldn't be read.
+    optional<string> SERIAL(header);
+    // Old saves only have the version and name in the cached header until their info is read.
+    bool SERIAL(withInfo) = false;
+    SERIALIZE_ALL(modified, size, header, withInfo)
+  };
+  Entry& getEntry(const FilePath&);
+  void load();
+  FilePath indexFile;
+  bool loaded = false;
+  bool changed = false;
+  map<string, Entry> entries;
+};
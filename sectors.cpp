@@ -15,10 +15,11 @@
 
 #include "stdafx.h"
 #include "sectors.h"
-#include "level.h"
+#include "pathfinding_context.h"
 #include <limits>
 
 Sectors::Sectors(Rectangle b, ExtraConnections con) : bounds(b), sectors(bounds, -1), extraConnections(std::move(con)) {
+  memoryCounter.set(bounds.area() * (sizeof(SectorId) + sizeof(optional<Vec2>)));
 }
 
 bool Sectors::same(Vec2 v, Vec2 w) const {
@@ -88,9 +89,8 @@ void Sectors::join(Vec2 pos1, SectorId sector) {
   }
 }
 
-static DirtyTable<int> bfsTable(Level::getMaxBounds(), -1);
-
-vector<Vec2> Sectors::getDisjoint(Vec2 pos) const {
+vector<Vec2> Sectors::getDisjoint(Vec2 pos, PathfindingContext& context) const {
+  auto& bfsTable = context.bfsTable;
   vector<queue<Vec2>> queues;
   bfsTable.clear();
   int numNeighbor = 0;
@@ -136,7 +136,11 @@ vector<Vec2> Sectors::getDisjoint(Vec2 pos) const {
 }
 
 bool Sectors::isChokePoint(Vec2 pos) const {
-  return !getDisjoint(pos).empty();
+  return isChokePoint(pos, PathfindingContext::forThisThread());
+}
+
+bool Sectors::isChokePoint(Vec2 pos, PathfindingContext& context) const {
+  return !getDisjoint(pos, context).empty();
 }
 
 vector<Vec2> Sectors::getNeighbors(Vec2 pos) const {
@@ -169,7 +173,7 @@ void Sectors::removeExtraConnection(Vec2 pos1, Vec2 pos2) {
   join(pos1, getNewSector());
 }
 
-const Sectors::ExtraConnections Sectors::getExtraConnections() const {
+const Sectors::ExtraConnections& Sectors::getExtraConnections() const {
   return extraConnections;
 }
 
@@ -190,7 +194,7 @@ bool Sectors::remove(Vec2 pos) {
     return false;
   --sizes[sectors[pos]];
   sectors[pos] = -1;
-  for (Vec2 v : getDisjoint(pos))
+  for (Vec2 v : getDisjoint(pos, PathfindingContext::forThisThread()))
     join(v, getNewSector());
   return true;
 }
@@ -16,6 +16,9 @@
 #pragma once
 
 #include "util.h"
+#include "memory_telemetry.h"
+
+class PathfindingContext;
 
 class Sectors {
   public:
@@ -29,9 +32,10 @@ class Sectors {
   bool contains(Vec2) const;
   int getNumSectors() const;
   bool isChokePoint(Vec2) const;
+  bool isChokePoint(Vec2, PathfindingContext&) const;
   void addExtraConnection(Vec2, Vec2);
   void removeExtraConnection(Vec2, Vec2);
-  const ExtraConnections getExtraConnections() const;
+  const ExtraConnections& getExtraConnections() const;
 
   using SectorId = short;
   SectorId getLargest() const;
@@ -42,10 +46,11 @@ class Sectors {
   void setSector(Vec2, SectorId);
   SectorId getNewSector();
   void join(Vec2, SectorId);
-  vector<Vec2> getDisjoint(Vec2) const;
+  vector<Vec2> getDisjoint(Vec2, PathfindingContext&) const;
   Rectangle bounds;
   Table<SectorId> sectors;
   vector<int> sizes;
   ExtraConnections extraConnections;
+  MemoryCounter memoryCounter {MemoryCategory::SECTORS};
 };
 
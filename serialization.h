@@ -111,6 +111,56 @@ void CLASS::serialize(Archive& ar1, const unsigned int) { \
   void serialize(Archive&, const unsigned int) { \
   }
 
+/** Types whose values are saved as their raw bytes by binary archives, so arrays of them can be written
+    in one call. For arithmetic types the output is the same as writing the elements one by one.*/
+template <typename T>
+struct IsBulkSerializable : std::is_arithmetic<T> {};
+
+template <class Archive, typename T>
+struct CanSerializeInBulk : std::integral_constant<bool, IsBulkSerializable<T>::value &&
+    (cereal::traits::is_output_serializable<cereal::BinaryData<T>, Archive>::value ||
+     cereal::traits::is_input_serializable<cereal::BinaryData<T>, Archive>::value)> {};
+
+template <class Archive, typename T>
+void serializeArray(Archive& ar, T* elems, size_t size, std::true_type) {
+  ar(cereal::binary_data(elems, size * sizeof(T)));
+}
+
+template <class Archive, typename T>
+void serializeArray(Archive& ar, T* elems, size_t size, std::false_type) {
+  for (size_t i = 0; i < size; ++i)
+    ar(elems[i]);
+}
+
+template <class Archive, typename T>
+void serializeArray(Archive& ar, T* elems, size_t size) {
+  serializeArray(ar, elems, size, CanSerializeInBulk<Archive, T>());
+}
+
+template <class Archive, typename T>
+void serializeVector(Archive& ar, std::vector<T>& v, std::true_type) {
+  cereal::size_type size = v.size();
+  ar(cereal::make_size_tag(size));
+  if (Archive::is_loading::value) {
+    if (size > 10000000)
+      throw cereal::Exception("Vector size too large");
+    v.resize(size);
+  }
+  serializeArray(ar, v.data(), v.size());
+}
+
+template <class Archive, typename T>
+void serializeVector(Archive& ar, std::vector<T>& v, std::false_type) {
+  ar(v);
+}
+
+// Cereal already writes vectors of arithmetic types in one call.
+template <class Archive, typename T>
+void serializeVector(Archive& ar, std::vector<T>& v) {
+  serializeVector(ar, v, std::integral_constant<bool,
+      CanSerializeInBulk<Archive, T>::value && !std::is_arithmetic<T>::value>());
+}
+
 template <class T, class U>
 class StreamCombiner {
   public:
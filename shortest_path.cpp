@@ -21,6 +21,8 @@
 #include "lasting_effect.h"
 #include "furniture.h"
 #include "furniture_usage.h"
+#include "pathfinding_context.h"
+#include "subsystem_timer.h"
 
 SERIALIZE_DEF(ShortestPath, path, target, bounds, reversed)
 SERIALIZATION_CONSTRUCTOR_IMPL(ShortestPath)
@@ -30,35 +32,21 @@ const double LevelShortestPath::infinity = 1000000000;
 
 const int revShortestLimit = 15;
 
-class DistanceTable {
-  public:
-  DistanceTable(Rectangle bounds) : ddist(bounds), dirty(bounds, 0) {}
+bool LevelShortestPath::useClusterGraph = true;
+bool LevelShortestPath::useFlowFields = true;
 
-  double getDistance(Vec2 v) const {
-    return dirty[v] < counter ? ShortestPath::infinity : ddist[v];
-  }
-
-  void setDistance(Vec2 v, double d) {
-    ddist[v] = d;
-    dirty[v] = counter;
-  }
+// Paths shorter than this are always found with a single exact search.
+const int minHierarchicalDistance = 40;
 
-  void clear() {
-    ++counter;
-  }
-
-  private:
-  Table<double> ddist;
-  Table<int> dirty;
-  int counter = 1;
-};
+// Exact search refines the abstract route in segments up to this long.
+const int refinementDistance = 24;
 
-static DistanceTable distanceTable(Level::getMaxBounds());
-static DirtyTable<double> navigationCostCache(Level::getMaxBounds(), 0);
+// A path read from a flow field is dropped if a creature blocks one of its first steps.
+const int flowFieldFreeSteps = 3;
 
 template <typename Fun>
-static auto getCached(Fun fun) {
-  return [fun] (Vec2 v) {
+static auto getCached(Fun fun, DirtyTable<double>& navigationCostCache) {
+  return [fun, &navigationCostCache] (Vec2 v) {
     if (navigationCostCache.isDirty(v))
       return navigationCostCache.getDirtyValue(v);
     else {
@@ -73,94 +61,113 @@ const int margin = 15;
 
 ShortestPath::ShortestPath(Rectangle a, function<double(Vec2)> entryFun, function<double(Vec2)> lengthFun,
     function<vector<Vec2>(Vec2)> directions, Vec2 to, Vec2 from, double mult) : ShortestPath(TemplateConstr{},
-    std::move(a), std::move(entryFun), std::move(lengthFun), std::move(directions), to, from, mult) {}
-
-template <typename EntryFun, typename LengthFun, typename DirectionsFun>
-ShortestPath::ShortestPath(TemplateConstr, Rectangle a, EntryFun entryFun, LengthFun lengthFun,
-    DirectionsFun directions, Vec2 to, Vec2 from, double mult) : target(to), bounds(a) {
+    PathfindingContext::forThisThread(), std::move(a), std::move(entryFun), std::move(lengthFun),
+    [directions = std::move(directions)](Vec2 pos, auto fun) {
+      for (Vec2 dir : directions(pos))
+        fun(pos + dir);
+    },
+    to, from, mult) {}
+
+bool ShortestPath::useBucketQueue = true;
+
+template <typename EntryFun, typename LengthFun, typename NeighborsFun>
+ShortestPath::ShortestPath(TemplateConstr, PathfindingContext& context, Rectangle a, EntryFun entryFun,
+    LengthFun lengthFun, NeighborsFun neighbors, Vec2 to, Vec2 from, double mult) : target(to), bounds(a) {
   PROFILE;
   CHECK(Level::getMaxBounds().contains(a));
-  navigationCostCache.clear();
+  auto& navigationCostCache = context.navigationCostCache;
+  auto search = [&] (optional<Vec2> from, optional<int> limit) {
+    navigationCostCache.clear();
+    if (useBucketQueue)
+      init(context, context.bucketQueue, getCached(entryFun, navigationCostCache), lengthFun, neighbors, target, from,
+          limit);
+    else
+      init(context, context.heapQueue, getCached(entryFun, navigationCostCache), lengthFun, neighbors, target, from,
+          limit);
+  };
   if (mult == 0)
-    init(getCached(entryFun), lengthFun, directions, target, from);
+    search(from, none);
   else {
-    init(getCached(entryFun), lengthFun, directions, target, none, revShortestLimit);
-    distanceTable.setDistance(target, infinity);
+    search(none, revShortestLimit);
+    context.distanceTable.setDistance(target, infinity);
     navigationCostCache.clear();
-    reverse(getCached(entryFun), lengthFun, directions, mult, from, revShortestLimit);
+    reverse(context, getCached(entryFun, navigationCostCache), lengthFun, neighbors, mult, from, revShortestLimit);
   }
 }
 
 ShortestPath::ShortestPath(Rectangle area, function<double (Vec2)> entryFun, function<double(Vec2)> lengthFun,
-    vector<Vec2> directions, Vec2 target, Vec2 from, double mult) : ShortestPath(area, entryFun, lengthFun,
-    [directions](Vec2) { return directions; }, target, from, mult)
-{
+    vector<Vec2> directions, Vec2 target, Vec2 from, double mult) : ShortestPath(TemplateConstr{},
+    PathfindingContext::forThisThread(), area, std::move(entryFun), std::move(lengthFun),
+    [directions = std::move(directions)](Vec2 pos, auto fun) {
+      for (Vec2 dir : directions)
+        fun(pos + dir);
+    },
+    target, from, mult) {
 }
 
-struct QueueElem {
-  Vec2 pos;
-  double value;
-};
-
-bool inline operator < (const QueueElem& e1, const QueueElem& e2) {
-  return e1.value > e2.value || (e1.value == e2.value && e1.pos < e2.pos);
+ShortestPath::ShortestPath(Rectangle area, const vector<Vec2>& p) : path(p.reverse()), target(p.back()), bounds(area),
+    reversed(false) {
 }
 
-template <typename EntryFun, typename LengthFun, typename DirectionsFun>
-void ShortestPath::init(EntryFun entryFun, LengthFun lengthFun, DirectionsFun directions,
-    Vec2 target, optional<Vec2> from, optional<int> limit) {
+template <typename Queue, typename EntryFun, typename LengthFun, typename NeighborsFun>
+void ShortestPath::init(PathfindingContext& context, Queue& q, EntryFun entryFun, LengthFun lengthFun,
+    NeighborsFun neighbors, Vec2 target, optional<Vec2> from, optional<int> limit) {
   PROFILE;
+  auto& distanceTable = context.distanceTable;
   reversed = false;
   distanceTable.clear();
-  function<QueueElem(Vec2)> makeElem;
-  if (from)
-    makeElem = [&](Vec2 pos) ->QueueElem { return {pos, distanceTable.getDistance(pos) + lengthFun(pos)}; };
-  else
-    makeElem = [&](Vec2 pos) ->QueueElem { return {pos, distanceTable.getDistance(pos)}; };
-  priority_queue<QueueElem, vector<QueueElem>> q;
+  q.clear();
+  auto getKey = [&](Vec2 pos, double dist) { return from ? dist + lengthFun(pos) : dist; };
   distanceTable.setDistance(target, 0);
-  q.push(makeElem(target));
+  q.push(getKey(target, 0), target);
   int numPopped = 0;
   while (!q.empty()) {
     ++numPopped;
-    Vec2 pos = q.top().pos;
+    ++numExpanded;
+    Vec2 pos = q.top();
     double posDist = distanceTable.getDistance(pos);
-   // INFO << "Popping " << pos << " " << distance[pos]  << " " << (from ? (*from - pos).length4() : 0);
-    if (from == pos || (limit && distanceTable.getDistance(pos) >= *limit)) {
-      INFO << "Shortest path from " << (from ? *from : Vec2(-1, -1)) << " to " << target << " " << numPopped
-        << " visited distance " << distanceTable.getDistance(pos);
-      constructPath(pos, directions);
+    if (from == pos || (limit && posDist >= *limit)) {
+      if (context.logging)
+        INFO << "Shortest path from " << (from ? *from : Vec2(-1, -1)) << " to " << target << " " << numPopped
+          << " visited distance " << posDist;
+      constructPath(context, pos, neighbors);
       return;
     }
     q.pop();
-    for (Vec2 dir : directions(pos)) {
-      PROFILE_BLOCK("loop body");
-      Vec2 next = pos + dir;
+    neighbors(pos, [&](Vec2 next) {
       if (next.inRectangle(bounds)) {
         double nextDist = distanceTable.getDistance(next);
         if (posDist < nextDist) {
-          PROFILE_BLOCK("check entry");
           double dist = posDist + entryFun(next);
           CHECK(dist > posDist) << "Entry fun non positive " << dist - posDist;
           if (dist < nextDist) {
             distanceTable.setDistance(next, dist);
-            {
-              PROFILE_BLOCK("queue push");
-              q.push(makeElem(next));
-            }
+            q.push(getKey(next, dist), next);
           }
         }
       }
-    }
+    });
   }
-  INFO << "Shortest path exhausted, " << numPopped << " visited";
+  if (context.logging)
+    INFO << "Shortest path exhausted, " << numPopped << " visited";
 }
 
-void ShortestPath::reverse(function<double(Vec2)> entryFun, function<double(Vec2)> lengthFun, function<vector<Vec2>(Vec2)> directions,
+struct QueueElem {
+  Vec2 pos;
+  double value;
+};
+
+bool inline operator < (const QueueElem& e1, const QueueElem& e2) {
+  return e1.value > e2.value || (e1.value == e2.value && e1.pos < e2.pos);
+}
+
+template <typename EntryFun, typename LengthFun, typename NeighborsFun>
+void ShortestPath::reverse(PathfindingContext& context, EntryFun entryFun, LengthFun lengthFun, NeighborsFun neighbors,
     double mult, Vec2 from, int limit) {
   PROFILE;
+  auto& distanceTable = context.distanceTable;
   reversed = true;
-  function<QueueElem(Vec2)> makeElem = [&](Vec2 pos)->QueueElem { return {pos, distanceTable.getDistance(pos) + lengthFun(pos)};};
+  auto makeElem = [&](Vec2 pos)->QueueElem { return {pos, distanceTable.getDistance(pos) + lengthFun(pos)};};
   priority_queue<QueueElem, vector<QueueElem>> q;
   for (Vec2 v : bounds) {
     double dist = distanceTable.getDistance(v);
@@ -172,39 +179,45 @@ void ShortestPath::reverse(function<double(Vec2)> entryFun, function<double(Vec2
   int numPopped = 0;
   while (!q.empty()) {
     ++numPopped;
+    ++numExpanded;
     Vec2 pos = q.top().pos;
     if (from == pos) {
-      INFO << "Rev shortest path from " << " from " << target << " " << numPopped << " visited";
-      constructPath(pos, directions, true);
+      if (context.logging)
+        INFO << "Rev shortest path from " << " from " << target << " " << numPopped << " visited";
+      constructPath(context, pos, neighbors, true);
       return;
     }
     q.pop();
-    for (Vec2 dir : directions(pos))
-      if ((pos + dir).inRectangle(bounds)) {
-        if (distanceTable.getDistance(pos + dir) > distanceTable.getDistance(pos) + entryFun(pos + dir) &&
-            distanceTable.getDistance(pos + dir) < 0) {
-          distanceTable.setDistance(pos + dir, distanceTable.getDistance(pos) + entryFun(pos + dir));
-          q.push(makeElem(pos + dir));
+    neighbors(pos, [&](Vec2 next) {
+      if (next.inRectangle(bounds)) {
+        if (distanceTable.getDistance(next) > distanceTable.getDistance(pos) + entryFun(next) &&
+            distanceTable.getDistance(next) < 0) {
+          distanceTable.setDistance(next, distanceTable.getDistance(pos) + entryFun(next));
+          q.push(makeElem(next));
         }
       }
+    });
   }
-  INFO << "Rev shortest path from " << " from " << target << " " << numPopped << " visited";
+  if (context.logging)
+    INFO << "Rev shortest path from " << " from " << target << " " << numPopped << " visited";
 }
 
-void ShortestPath::constructPath(Vec2 pos, function<vector<Vec2>(Vec2)> directions, bool reversed) {
+template <typename NeighborsFun>
+void ShortestPath::constructPath(PathfindingContext& context, Vec2 pos, NeighborsFun neighbors, bool reversed) {
+  auto& distanceTable = context.distanceTable;
   vector<Vec2> ret;
   auto origPos = pos;
   while (pos != target) {
     Vec2 next;
     double lowest = distanceTable.getDistance(pos);
     CHECK(lowest < infinity);
-    for (Vec2 dir : directions(pos)) {
+    neighbors(pos, [&](Vec2 v) {
       double dist;
-      if ((pos + dir).inRectangle(bounds) && (dist = distanceTable.getDistance(pos + dir)) < lowest) {
+      if (v.inRectangle(bounds) && (dist = distanceTable.getDistance(v)) < lowest) {
         lowest = dist;
-        next = pos + dir;
+        next = v;
       }
-    }
+    });
     if (lowest >= distanceTable.getDistance(pos)) {
       if (reversed)
         break;
@@ -228,6 +241,22 @@ const vector<Vec2>& ShortestPath::getPath() const {
   return path;
 }
 
+int ShortestPath::getNumExpanded() const {
+  return numExpanded;
+}
+
+ShortestPath ShortestPath::join(const vector<ShortestPath>& paths) {
+  CHECK(!paths.empty());
+  ShortestPath ret = paths.back();
+  for (int i = paths.size() - 2; i >= 0; --i) {
+    auto& elem = paths[i];
+    CHECK(!elem.reversed && elem.target == ret.path.back());
+    ret.path.append(elem.path.getSuffix(elem.path.size() - 1));
+    ret.numExpanded += elem.numExpanded;
+  }
+  return ret;
+}
+
 bool ShortestPath::isReachable(Vec2 pos) const {
   return (path.size() >= 2 && path.back() == pos) || (path.size() >= 3 && path[path.size() - 2] == pos);
 }
@@ -253,34 +282,33 @@ Vec2 ShortestPath::getTarget() const {
   return target;
 }
 
-ShortestPath LevelShortestPath::makeShortestPath(Position from, MovementType movementType, Position to, double mult,
-    vector<Vec2>* visited) {
+ShortestPath LevelShortestPath::makeShortestPath(PathfindingContext& context, Position from,
+    MovementType movementType, Position to, double mult, vector<Vec2>* visited, optional<Rectangle> area) {
   PROFILE;
   WLevel level = from.getLevel();
-  Rectangle bounds = level->getBounds();
+  Rectangle bounds = area ? area->intersection(level->getBounds()) : level->getBounds();
   CHECK(to.isSameLevel(from));
-  auto& sectors = level->getSectors(movementType);
-  auto& movementSectors = level->getSectors(copyOf(movementType).setCanBuildBridge(false).setDestroyActions({}));
-  auto entryFun = [=, &sectors, &movementSectors, fromCoord = from.getCoord()](Vec2 v) {
+  auto& navigationCosts = level->getNavigationCosts(movementType);
+  auto entryFun = [=, &navigationCosts, fromCoord = from.getCoord()](Vec2 v) {
     PROFILE_BLOCK("entry fun");
     if (visited)
       visited->push_back(v);
     if (fromCoord == v)
       return 1.0;
-    if (!sectors.contains(v))
-      return ShortestPath::infinity;
-    return Position(v, level, Position::IsValid{}).getNavigationCost(movementType, movementSectors);
+    if (navigationCosts.isFreeMovement(v) && Position(v, level, Position::IsValid{}).getCreature())
+      return 5.0;
+    return navigationCosts.get(v);
   };
-  auto directionsFun = [=] (Vec2 v) {
+  auto neighborsFun = [level] (Vec2 v, auto fun) {
+    for (Vec2 dir : Vec2::directions8())
+      fun(v + dir);
     Position pos(v, level);
-    vector<Vec2> ret = Vec2::directions8();
-    if (auto f = pos.getFurniture(FurnitureLayer::MIDDLE))
-      if (f->hasUsageType(BuiltinUsageId::PORTAL))
-        if (auto otherPos = pos.getOtherPortal())
+    if (auto otherPos = pos.getOtherPortal())
+      if (auto f = pos.getFurniture(FurnitureLayer::MIDDLE))
+        if (f->hasUsageType(BuiltinUsageId::PORTAL))
           if (auto f2 = otherPos->getFurniture(FurnitureLayer::MIDDLE))
             if (f2->hasUsageType(BuiltinUsageId::PORTAL))
-              ret.push_back(otherPos->getCoord() - v);
-    return ret;
+              fun(otherPos->getCoord());
   };
   CHECK(to.getCoord().inRectangle(level->getBounds()));
   CHECK(from.getCoord().inRectangle(level->getBounds()));
@@ -292,15 +320,64 @@ ShortestPath LevelShortestPath::makeShortestPath(Position from, MovementType mov
       // Use a suboptimal, but faster pathfinding.
       return 2 * min<double>(from.dist8(to) + 0.01 * from.distD(to), dist1 + dist2);
     };
-    return ShortestPath(ShortestPath::TemplateConstr{}, bounds, entryFun, lengthFun, directionsFun, to.getCoord(), from.getCoord(), mult);
+    return ShortestPath(ShortestPath::TemplateConstr{}, context, bounds, entryFun, lengthFun, neighborsFun, to.getCoord(), from.getCoord(), mult);
   } else {
     auto lengthFun = [from = from.getCoord()](Vec2 to)->double { return from.dist8(to); };
     Vec2 vTo = to.getCoord();
     Vec2 vFrom = from.getCoord();
     bounds = bounds.intersection(Rectangle(min(vTo.x, vFrom.x) - margin, min(vTo.y, vFrom.y) - margin,
         max(vTo.x, vFrom.x) + margin, max(vTo.y, vFrom.y) + margin));
-    return ShortestPath(ShortestPath::TemplateConstr{}, bounds, entryFun, lengthFun, directionsFun, to.getCoord(), from.getCoord(), mult);
+    return ShortestPath(ShortestPath::TemplateConstr{}, context, bounds, entryFun, lengthFun, neighborsFun, to.getCoord(), from.getCoord(), mult);
+  }
+}
+
+optional<ShortestPath> LevelShortestPath::makeFlowFieldPath(Position from, MovementType movementType, Position to) {
+  PROFILE;
+  WLevel level = from.getLevel();
+  auto field = level->getFlowFields().get({to.getCoord()}, movementType, [&] {
+    // The field is shared by many creatures, so it skips the part of the navigation cost that depends on creatures.
+    auto& navigationCosts = level->getNavigationCosts(movementType);
+    return FlowField(level->getBounds(), {to.getCoord()}, level->getSectors(movementType),
+        [&](Vec2 v) { return navigationCosts.get(v); });
+  });
+  if (!field)
+    return none;
+  auto path = field->getPath(from.getCoord());
+  if (path.size() < 2)
+    return none;
+  for (int i : Range(1, min<int>(path.size(), flowFieldFreeSteps + 1)))
+    if (Position(path[i], level).getCreature())
+      return none;
+  return ShortestPath(level->getBounds(), path);
+}
+
+optional<ShortestPath> LevelShortestPath::makeHierarchicalPath(Position from, MovementType movementType, Position to,
+    vector<Vec2>* visited, int& numExpanded) {
+  PROFILE;
+  WLevel level = from.getLevel();
+  auto& sectors = level->getSectors(movementType);
+  // The cluster graph is shared by all searches, so its costs can't depend on creatures standing in the way.
+  // The cost grid leaves them out too, and the level invalidates the graph when one of its costs changes.
+  auto& navigationCosts = level->getNavigationCosts(movementType);
+  auto costFun = [&navigationCosts](Vec2 v) { return navigationCosts.get(v); };
+  auto waypoints = level->getClusterGraph(movementType).findPath(from.getCoord(), to.getCoord(), sectors, costFun,
+      &numExpanded);
+  if (!waypoints)
+    return none;
+  vector<ShortestPath> segments;
+  Vec2 segmentStart = from.getCoord();
+  for (int i : All(*waypoints)) {
+    Vec2 v = (*waypoints)[i];
+    if (i < waypoints->size() - 1 && (*waypoints)[i + 1].dist8(segmentStart) <= refinementDistance)
+      continue;
+    auto segment = makeShortestPath(PathfindingContext::forThisThread(), Position(segmentStart, level), movementType, Position(v, level), 0, visited,
+        Rectangle::boundingBox({segmentStart, v}).minusMargin(-margin));
+    if (segment.getPath().size() < 2)
+      return none;
+    segments.push_back(std::move(segment));
+    segmentStart = v;
   }
+  return ShortestPath::join(segments);
 }
 
 SERIALIZE_DEF(LevelShortestPath, path, level)
@@ -311,7 +388,55 @@ LevelShortestPath::LevelShortestPath(const Creature* creature, Position target,
     : LevelShortestPath(creature->getPosition(), creature->getMovementType(), target, mult, visited) {}
 
 LevelShortestPath::LevelShortestPath(Position from, MovementType type, Position to, double mult, vector<Vec2>* visited)
-    : path(makeShortestPath(from, type, to, mult, visited)), level(to.getLevel()) {
+    : level(to.getLevel()) {
+  SubsystemTimer timer(Subsystem::PATHFINDING);
+  optional<ShortestPath> fastPath;
+  if (mult == 0 && useFlowFields && !visited)
+    fastPath = makeFlowFieldPath(from, type, to);
+  if (!fastPath && mult == 0 && useClusterGraph && *from.dist8(to) > minHierarchicalDistance)
+    fastPath = makeHierarchicalPath(from, type, to, visited, numExpanded);
+  path = fastPath ? std::move(*fastPath)
+      : makeShortestPath(PathfindingContext::forThisThread(), from, type, to, mult, visited);
+}
+
+LevelShortestPath::LevelShortestPath(ShortestPath p, WLevel l) : path(std::move(p)), level(l) {
+}
+
+vector<LevelShortestPath> LevelShortestPath::findPaths(const vector<Request>& requests, int numThreads) {
+  PROFILE;
+  // Sectors and cost grids are created lazily, so all that the searches will read must exist before the workers start.
+  for (auto& request : requests) {
+    CHECK(request.from.isSameLevel(request.to));
+    auto level = request.from.getLevel();
+    level->getSectors(request.movement);
+    level->getNavigationCosts(request.movement);
+  }
+  vector<LevelShortestPath> ret(requests.size());
+  atomic<int> nextRequest(0);
+  auto work = [&] {
+    SubsystemTimer timer(Subsystem::PATHFINDING);
+    auto& context = PathfindingContext::forThisThread();
+    bool wasLogging = context.logging;
+    // The log isn't thread-safe.
+    context.logging = false;
+    for (int index = nextRequest++; index < requests.size(); index = nextRequest++) {
+      auto& request = requests[index];
+      ret[index] = LevelShortestPath(makeShortestPath(context, request.from, request.movement, request.to, 0, nullptr),
+          request.to.getLevel());
+    }
+    context.logging = wasLogging;
+  };
+  vector<thread> threads;
+  for (int i : Range(numThreads - 1))
+    threads.push_back(makeThread(work));
+  work();
+  for (auto& t : threads)
+    t.join();
+  return ret;
+}
+
+int LevelShortestPath::getNumExpanded() const {
+  return path.getNumExpanded() + numExpanded;
 }
 
 WLevel LevelShortestPath::getLevel() const {
@@ -350,87 +475,51 @@ bool LevelShortestPath::isReversed() const {
 }
 
 Dijkstra::Dijkstra(Rectangle bounds, vector<Vec2> from, int maxDist, function<double(Vec2)> entryFun,
-      vector<Vec2> directions) {
-  distanceTable.clear();
-  auto comparator = [](Vec2 pos1, Vec2 pos2) {
-      double diff = distanceTable.getDistance(pos1) - distanceTable.getDistance(pos2);
-      if (diff > 0 || (diff == 0 && pos1 < pos2))
-        return 1;
-      else
-        return 0;};
-  priority_queue<Vec2, vector<Vec2>, decltype(comparator)> q(comparator) ;
-  for (auto& v : from) {
-    distanceTable.setDistance(v, 0);
-    q.push(v);
-  }
-  int numPopped = 0;
-  while (!q.empty()) {
-    ++numPopped;
-    Vec2 pos = q.top();
-    double cdist = distanceTable.getDistance(pos);
-    if (cdist > maxDist)
-      return;
-    q.pop();
-    CHECK(!reachable.count(pos));
-    reachable[pos] = cdist;
-    for (Vec2 dir : directions) {
-      Vec2 next = pos + dir;
-      if (next.inRectangle(bounds)) {
-        double ndist = distanceTable.getDistance(next);
-        if (cdist < ndist) {
-          double dist = cdist + entryFun(next);
-          CHECK(dist > cdist) << "Entry fun non positive " << dist - cdist;
-          if (dist < ndist && dist <= maxDist) {
-            distanceTable.setDistance(next, dist);
-            q.push(next);
-          }
-        }
-      }
-    }
-  }
+      vector<Vec2> directions) : Dijkstra(PathfindingContext::forThisThread(), bounds, std::move(from), maxDist,
+      std::move(entryFun), std::move(directions)) {
+}
 
+Dijkstra::Dijkstra(PathfindingContext& context, Rectangle bounds, vector<Vec2> from, int maxDist,
+      function<double(Vec2)> entryFun, vector<Vec2> directions) : distance(bounds, ShortestPath::infinity) {
+  visit(context, bounds, from, maxDist, entryFun, [&](Vec2 v, double dist) {
+    if (v.inRectangle(bounds)) {
+      distance[v] = dist;
+      reachable.push_back(v);
+    }
+  }, directions);
 }
 
 bool Dijkstra::isReachable(Vec2 pos) const {
-  return reachable.count(pos);
+  return pos.inRectangle(distance.getBounds()) && distance[pos] < ShortestPath::infinity;
 }
 
 double Dijkstra::getDist(Vec2 v) const {
-  return reachable.at(v);
+  CHECK(isReachable(v));
+  return distance[v];
 }
 
-const map<Vec2, double>& Dijkstra::getAllReachable() const {
+const vector<Vec2>& Dijkstra::getAllReachable() const {
   return reachable;
 }
 
-BfSearch::BfSearch(Rectangle bounds, Vec2 from, function<bool(Vec2)> entryFun, vector<Vec2> directions) {
-  distanceTable.clear();
-  queue<Vec2> q;
-  distanceTable.setDistance(from, 0);
-  q.push(from);
-  int numPopped = 0;
-  while (!q.empty()) {
-    ++numPopped;
-    Vec2 pos = q.front();
-    q.pop();
-    CHECK(!reachable.count(pos));
-    reachable.insert(pos);
-    for (Vec2 dir : directions) {
-      Vec2 next = pos + dir;
-      if (next.inRectangle(bounds) && distanceTable.getDistance(next) == ShortestPath::infinity && entryFun(next)) {
-        distanceTable.setDistance(next, 0);
-        q.push(next);
-      }
-    }
-  }
+BfSearch::BfSearch(Rectangle bounds, Vec2 from, function<bool(Vec2)> entryFun, vector<Vec2> directions)
+    : BfSearch(PathfindingContext::forThisThread(), bounds, from, std::move(entryFun), std::move(directions)) {
+}
 
+BfSearch::BfSearch(PathfindingContext& context, Rectangle bounds, Vec2 from, function<bool(Vec2)> entryFun,
+    vector<Vec2> directions) : reached(bounds, false) {
+  visit(context, bounds, {from}, std::numeric_limits<int>::max(), entryFun, [&](Vec2 v, int) {
+    if (v.inRectangle(bounds)) {
+      reached[v] = true;
+      reachable.push_back(v);
+    }
+  }, directions);
 }
 
 bool BfSearch::isReachable(Vec2 pos) const {
-  return reachable.count(pos);
+  return pos.inRectangle(reached.getBounds()) && reached[pos];
 }
 
-const set<Vec2>& BfSearch::getAllReachable() const {
+const vector<Vec2>& BfSearch::getAllReachable() const {
   return reachable;
 }
-
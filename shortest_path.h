@@ -19,6 +19,8 @@
 
 #include "util.h"
 #include "position.h"
+#include "movement_type.h"
+#include "pathfinding_context.h"
 
 class Creature;
 class Level;
@@ -34,10 +36,12 @@ class ShortestPath {
       Vec2 from,
       double mult = 0);
 
+  /** Main search engine. NeighborsFun is called with a tile and a callback, which it must call for every
+      neighbor of the tile. The other constructors are adapters to this one.*/
   struct TemplateConstr {};
-  template <typename EntryFun, typename LengthFun, typename DirectionsFun>
-  ShortestPath(TemplateConstr, Rectangle area, EntryFun entryFun, LengthFun lengthFun, DirectionsFun directions,
-      Vec2 target, Vec2 from, double mult = 0);
+  template <typename EntryFun, typename LengthFun, typename NeighborsFun>
+  ShortestPath(TemplateConstr, PathfindingContext&, Rectangle area, EntryFun entryFun, LengthFun lengthFun,
+      NeighborsFun neighbors, Vec2 target, Vec2 from, double mult = 0);
 
   ShortestPath(
       Rectangle area,
@@ -47,27 +51,42 @@ class ShortestPath {
       Vec2 target,
       Vec2 from,
       double mult = 0);
+
+  /** Wraps an already computed path, which starts at the first element.*/
+  ShortestPath(Rectangle area, const vector<Vec2>& path);
+
   bool isReachable(Vec2 pos) const;
   Vec2 getNextMove(Vec2 pos);
   optional<Vec2> getNextNextMove(Vec2 pos);
   Vec2 getTarget() const;
   bool isReversed() const;
   const vector<Vec2>& getPath() const;
+  int getNumExpanded() const;
+
+  /** Concatenates paths where each one starts at the target of the previous one.*/
+  static ShortestPath join(const vector<ShortestPath>&);
 
   static const double infinity;
 
+  /** Switches the search between the bucket queue and a binary heap. Used for benchmarking.*/
+  static bool useBucketQueue;
+
   SERIALIZATION_DECL(ShortestPath)
 
   private:
-  template <typename EntryFun, typename LengthFun, typename DirectionsFun>
-  void init(EntryFun entryFun, LengthFun lengthFun, DirectionsFun directions,
-      Vec2 target, optional<Vec2> from, optional<int> limit = none);
-  void reverse(function<double(Vec2)> entryFun, function<double(Vec2)> lengthFun, function<vector<Vec2>(Vec2)> directions, double mult, Vec2 from, int limit);
-  void constructPath(Vec2 start, function<vector<Vec2>(Vec2)> directions, bool reversed = false);
+  template <typename Queue, typename EntryFun, typename LengthFun, typename NeighborsFun>
+  void init(PathfindingContext&, Queue&, EntryFun entryFun, LengthFun lengthFun, NeighborsFun neighbors,
+      Vec2 target, optional<Vec2> from, optional<int> limit);
+  template <typename EntryFun, typename LengthFun, typename NeighborsFun>
+  void reverse(PathfindingContext&, EntryFun entryFun, LengthFun lengthFun, NeighborsFun neighbors, double mult,
+      Vec2 from, int limit);
+  template <typename NeighborsFun>
+  void constructPath(PathfindingContext&, Vec2 start, NeighborsFun neighbors, bool reversed = false);
   vector<Vec2> SERIAL(path);
   Vec2 SERIAL(target);
   Rectangle SERIAL(bounds);
   bool SERIAL(reversed);
+  int numExpanded = 0;
 };
 
 class LevelShortestPath {
@@ -81,36 +100,140 @@ class LevelShortestPath {
   bool isReversed() const;
   WLevel getLevel() const;
   vector<Position> getPath() const;
+  int getNumExpanded() const;
+
+  struct Request {
+    Position from;
+    MovementType movement;
+    Position to;
+  };
+
+  /** Finds paths for many requests in parallel, using the exact search. The results are identical
+      for any number of threads.*/
+  static vector<LevelShortestPath> findPaths(const vector<Request>&, int numThreads);
 
   static const double infinity;
 
+  /** Long paths are routed through the level's ClusterGraph and refined locally. Switch off to always
+      run the exact search over the whole level.*/
+  static bool useClusterGraph;
+
+  /** Paths to destinations requested by many creatures are read from the level's FlowFieldCache.*/
+  static bool useFlowFields;
+
   SERIALIZATION_DECL(LevelShortestPath)
 
   private:
-  static ShortestPath makeShortestPath(Position, MovementType, Position to, double mult, vector<Vec2>* visited);
+  LevelShortestPath(ShortestPath, WLevel);
+  static ShortestPath makeShortestPath(PathfindingContext&, Position, MovementType, Position to, double mult,
+      vector<Vec2>* visited, optional<Rectangle> bounds = none);
+  static optional<ShortestPath> makeFlowFieldPath(Position, MovementType, Position to);
+  static optional<ShortestPath> makeHierarchicalPath(Position, MovementType, Position to, vector<Vec2>* visited,
+      int& numExpanded);
   ShortestPath SERIAL(path);
   WLevel SERIAL(level) = nullptr;
+  int numExpanded = 0;
 };
 
 class Dijkstra {
   public:
   Dijkstra(Rectangle bounds, vector<Vec2> from, int maxDist, function<double(Vec2)> entryFun,
       vector<Vec2> directions = Vec2::directions8());
+  Dijkstra(PathfindingContext&, Rectangle bounds, vector<Vec2> from, int maxDist, function<double(Vec2)> entryFun,
+      vector<Vec2> directions = Vec2::directions8());
   bool isReachable(Vec2) const;
   double getDist(Vec2) const;
-  const map<Vec2, double>& getAllReachable() const;
+  const vector<Vec2>& getAllReachable() const;
+
+  /** Calls visitFun(Vec2, double) for every tile within maxDist of the sources, in order of distance, without
+      storing the results. The callback must not start other searches on the same context.*/
+  template <typename EntryFun, typename VisitFun>
+  static void visit(PathfindingContext&, Rectangle bounds, const vector<Vec2>& from, double maxDist, EntryFun entryFun,
+      VisitFun visitFun, const vector<Vec2>& directions = Vec2::directions8());
 
   private:
-  map<Vec2, double> reachable;
+  Table<double> distance;
+  vector<Vec2> reachable;
 };
 
 class BfSearch {
   public:
   BfSearch(Rectangle bounds, Vec2 from, function<bool(Vec2)> entryFun, vector<Vec2> directions = Vec2::directions8());
+  BfSearch(PathfindingContext&, Rectangle bounds, Vec2 from, function<bool(Vec2)> entryFun,
+      vector<Vec2> directions = Vec2::directions8());
   bool isReachable(Vec2) const;
-  const set<Vec2>& getAllReachable() const;
+  const vector<Vec2>& getAllReachable() const;
+
+  /** Calls visitFun(Vec2, int) for every tile up to maxDist steps from the sources, in order of distance, without
+      storing the results. Sources are visited even if entryFun rejects them. The callback must not start other
+      searches on the same context.*/
+  template <typename EntryFun, typename VisitFun>
+  static void visit(PathfindingContext&, Rectangle bounds, const vector<Vec2>& from, int maxDist, EntryFun entryFun,
+      VisitFun visitFun, const vector<Vec2>& directions = Vec2::directions8());
 
   private:
-  set<Vec2> reachable;
+  Table<bool> reached;
+  vector<Vec2> reachable;
 };
 
+template <typename EntryFun, typename VisitFun>
+void Dijkstra::visit(PathfindingContext& context, Rectangle bounds, const vector<Vec2>& from, double maxDist,
+    EntryFun entryFun, VisitFun visitFun, const vector<Vec2>& directions) {
+  auto& distanceTable = context.distanceTable;
+  auto& q = context.heapQueue;
+  distanceTable.clear();
+  q.clear();
+  for (auto& v : from) {
+    distanceTable.setDistance(v, 0);
+    q.push(0, v);
+  }
+  while (!q.empty()) {
+    Vec2 pos = q.top();
+    double cdist = q.getTopKey();
+    q.pop();
+    if (cdist > distanceTable.getDistance(pos))
+      continue;
+    visitFun(pos, cdist);
+    for (Vec2 dir : directions) {
+      Vec2 next = pos + dir;
+      if (next.inRectangle(bounds)) {
+        double ndist = distanceTable.getDistance(next);
+        if (cdist < ndist) {
+          double dist = cdist + entryFun(next);
+          CHECK(dist > cdist) << "Entry fun non positive " << dist - cdist;
+          if (dist < ndist && dist <= maxDist) {
+            distanceTable.setDistance(next, dist);
+            q.push(dist, next);
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename EntryFun, typename VisitFun>
+void BfSearch::visit(PathfindingContext& context, Rectangle bounds, const vector<Vec2>& from, int maxDist,
+    EntryFun entryFun, VisitFun visitFun, const vector<Vec2>& directions) {
+  auto& distanceTable = context.distanceTable;
+  distanceTable.clear();
+  queue<Vec2> q;
+  for (auto& v : from)
+    if (distanceTable.getDistance(v) > 0) {
+      distanceTable.setDistance(v, 0);
+      q.push(v);
+    }
+  while (!q.empty()) {
+    Vec2 pos = q.front();
+    q.pop();
+    int dist = distanceTable.getDistance(pos);
+    visitFun(pos, dist);
+    if (dist < maxDist)
+      for (Vec2 dir : directions) {
+        Vec2 next = pos + dir;
+        if (next.inRectangle(bounds) && distanceTable.getDistance(next) == DistanceTable::infinity && entryFun(next)) {
+          distanceTable.setDistance(next, dist + 1);
+          q.push(next);
+        }
+      }
+  }
+}
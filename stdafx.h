@@ -135,6 +135,7 @@ using boost::this_thread::sleep_for;
 using boost::chrono::duration;
 using boost::chrono::milliseconds;
 using boost::chrono::microseconds;
+using boost::chrono::nanoseconds;
 using boost::chrono::steady_clock;
 using boost::chrono::high_resolution_clock;
 using boost::chrono::duration_cast;
@@ -145,6 +146,7 @@ using std::this_thread::sleep_for;
 using std::chrono::duration;
 using std::chrono::milliseconds;
 using std::chrono::microseconds;
+using std::chrono::nanoseconds;
 using std::chrono::steady_clock;
 using std::chrono::high_resolution_clock;
 using std::chrono::duration_cast;
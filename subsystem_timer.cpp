@@ -0,0 +1,36 @@
+#include "stdafx.h"
+#include "subsystem_timer.h"
+
+static atomic<bool> enabled(false);
+static atomic<long long> totals[EnumInfo<Subsystem>::size];
+static thread_local SubsystemTimer* current = nullptr;
+
+SubsystemTimer::SubsystemTimer(Subsystem s) : subsystem(s), active(enabled), parent(current) {
+  if (active) {
+    current = this;
+    start = steady_clock::now();
+  }
+}
+
+SubsystemTimer::~SubsystemTimer() {
+  if (active) {
+    auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+    totals[int(subsystem)] += (elapsed - childTime).count();
+    if (parent)
+      parent->childTime += elapsed;
+    current = parent;
+  }
+}
+
+void SubsystemTimer::setEnabled(bool e) {
+  enabled = e;
+}
+
+void SubsystemTimer::reset() {
+  for (auto& elem : totals)
+    elem = 0;
+}
+
+nanoseconds SubsystemTimer::getTotal(Subsystem s) {
+  return nanoseconds(totals[int(s)]);
+}
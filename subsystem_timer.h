@@ -0,0 +1,32 @@
+#pragma once
+
+#include "util.h"
+
+RICH_ENUM(Subsystem,
+  MODEL_TICK,
+  COLLECTIVE_TICK,
+  MONSTER_AI,
+  PATHFINDING,
+  FIELD_OF_VIEW,
+  EVENTS
+);
+
+/** Measures the time spent in a part of the game logic until the end of the scope. Timers can be nested,
+    in which case the time of the inner one isn't counted to the outer one. Does nothing unless enabled.*/
+class SubsystemTimer {
+  public:
+  SubsystemTimer(Subsystem);
+  ~SubsystemTimer();
+
+  static void setEnabled(bool);
+  static void reset();
+  /** Returns the time spent in the subsystem since the last reset, summed over all threads.*/
+  static nanoseconds getTotal(Subsystem);
+
+  private:
+  Subsystem subsystem;
+  bool active;
+  steady_clock::time_point start;
+  nanoseconds childTime {0};
+  SubsystemTimer* parent;
+};
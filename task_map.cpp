@@ -29,6 +29,7 @@ void TaskMap::serialize(Archive& ar, const unsigned int) {
         if (isPriorityTask(task))
           priorityTaskByActivity[activity].insertIfDoesntContain(task);
     }
+    updateMemoryCounter();
   }
 }
 
@@ -36,6 +37,13 @@ SERIALIZABLE(TaskMap);
 
 SERIALIZATION_CONSTRUCTOR_IMPL(TaskMap);
 
+void TaskMap::updateMemoryCounter() {
+  // Every task is also an entry in a few of the lookup maps.
+  const int indexBytesPerTask = 256;
+  memoryCounter.set(tasks.size() * (sizeof(Task) + indexBytesPerTask) +
+      (marked.size() + highlight.size()) * (sizeof(Position) + sizeof(void*) * 3));
+}
+
 void TaskMap::tick() {
   for (WTask t : getWeakPointers(tasks)) {
     if (t->isDone())
@@ -63,7 +71,7 @@ void TaskMap::tick() {
 
 WTask TaskMap::getClosestTask(const Creature* c, MinionActivity activity, bool priorityOnly, const Collective* col) const {
   auto header = "getClosestTask " + EnumInfo<MinionActivity>::getString(activity);
-  PROFILE_BLOCK(header.data());
+  PROFILE_BLOCK(header);
   WTask closest = nullptr;
   auto isBetter = [&](WTask task, optional<int> dist) {
     PROFILE_BLOCK("isBetter");
@@ -167,6 +175,7 @@ CostInfo TaskMap::removeTask(WTask task) {
       tasks.removeIndex(i);
       break;
     }
+  updateMemoryCounter();
   return cost;
 }
 
@@ -257,6 +266,7 @@ WTask TaskMap::addTaskFor(PTask task, Creature* c) {
     setPosition(task.get(), *pos);
   taskById.set(task->getUniqueId(), task.get());
   tasks.push_back(std::move(task));
+  updateMemoryCounter();
   return tasks.back().get();
 }
 
@@ -267,6 +277,7 @@ WTask TaskMap::addTask(PTask task, Position position, MinionActivity activity) {
   CHECK(!activityByTask.getMaybe(task.get()));
   activityByTask.set(task.get(), activity);
   tasks.push_back(std::move(task));
+  updateMemoryCounter();
   return tasks.back().get();
 }
 
@@ -9,6 +9,7 @@
 #include "game_time.h"
 #include "minion_activity.h"
 #include "indexed_vector.h"
+#include "memory_telemetry.h"
 
 class Task;
 class Creature;
@@ -64,5 +65,7 @@ class TaskMap {
   void releaseOnHoldTask(Task*);
   void setPosition(WTask, Position);
   void addToTaskByActivity(Task*, MinionActivity);
+  void updateMemoryCounter();
+  MemoryCounter memoryCounter {MemoryCategory::TASK_MAPS};
 };
 
@@ -3,6 +3,8 @@
 #include "position.h"
 #include "movement_type.h"
 #include "position_map.h"
+#include "shortest_path.h"
+#include "level.h"
 
 SERIALIZE_DEF(Territory, allSquares, allSquaresVec, centralPoint)
 
@@ -43,27 +45,26 @@ const PositionSet& Territory::getAllAsSet() const {
 
 vector<Position> Territory::calculateExtended(int minRadius, int maxRadius) const {
   PROFILE;
-  PositionMap<int> extendedTiles;
-  vector<Position> extendedQueue;
+  vector<WLevel> levels;
+  unordered_map<WLevel, vector<Vec2>, CustomHash<WLevel>> sources;
   for (Position pos : allSquaresVec) {
-    if (!extendedTiles.contains(pos))  {
-      extendedTiles.set(pos, 1);
-      extendedQueue.push_back(pos);
-    }
+    auto level = pos.getLevel();
+    if (!sources.count(level))
+      levels.push_back(level);
+    sources[level].push_back(pos.getCoord());
   }
-  for (int i = 0; i < extendedQueue.size(); ++i) {
-    Position pos = extendedQueue[i];
-    auto value = extendedTiles.getOrFail(pos);
-    for (Position v : pos.neighbors8())
-      if (!contains(v) && !extendedTiles.contains(v) && v.canEnterEmpty({MovementTrait::WALK})) {
-        extendedTiles.set(v, value + 1);
-        if (value + 1 < maxRadius)
-          extendedQueue.push_back(v);
-      }
-  }
-  if (minRadius > 0)
-    return extendedQueue.filter([&] (const Position& v) { return extendedTiles.getOrFail(v) >= minRadius; });
-  return extendedQueue;
+  vector<Position> ret;
+  for (auto level : levels)
+    BfSearch::visit(PathfindingContext::forThisThread(), level->getBounds(), sources.at(level), maxRadius - 2,
+        [&](Vec2 v) {
+          Position pos(v, level);
+          return !contains(pos) && pos.canEnterEmpty({MovementTrait::WALK});
+        },
+        [&](Vec2 v, int dist) {
+          if (dist >= minRadius - 1)
+            ret.push_back(Position(v, level));
+        });
+  return ret;
 }
 
 const vector<Position>& Territory::getStandardExtended() const {
@@ -23,6 +23,13 @@
 #include "level_maker.h"
 #include "test.h"
 #include "sectors.h"
+#include "cluster_graph.h"
+#include "flow_field.h"
+#include "pathfinding_context.h"
+#include "navigation_cost_grid.h"
+#include "compressed_stream.h"
+#include "field_of_view.h"
+#include "time_queue.h"
 #include "minion_equipment.h"
 #include "item_factory.h"
 #include "item_type.h"
@@ -49,6 +56,7 @@
 #include "biome_id.h"
 #include "item_types.h"
 #include "creature_attributes.h"
+#include "memory_telemetry.h"
 
 class Test {
   public:
@@ -541,6 +549,506 @@ class Test {
     CHECK(!s.same(Vec2(0, 0), Vec2(5, 5)));
   }
 
+  void testClusterGraph() {
+    Rectangle bounds(100, 100);
+    Sectors s(bounds, Table<optional<Vec2>>(bounds));
+    ClusterGraph graph(bounds, 8);
+    for (Vec2 v : bounds)
+      if (!Random.roll(3))
+        s.add(v);
+    auto costFun = [](Vec2) { return 1.0; };
+    auto checkPaths = [&] {
+      for (int i : Range(200)) {
+        Vec2 from = bounds.randomVec2();
+        Vec2 to = bounds.randomVec2();
+        if (!s.contains(from) || !s.contains(to))
+          continue;
+        auto path = graph.findPath(from, to, s, costFun);
+        CHECK(!!path == s.same(from, to)) << from << " " << to;
+        if (path) {
+          CHECK(path->back() == to);
+          for (Vec2 v : *path)
+            CHECK(s.same(from, v));
+        }
+      }
+    };
+    checkPaths();
+    for (int i : Range(1000)) {
+      Vec2 v = bounds.randomVec2();
+      if (Random.roll(3))
+        s.remove(v);
+      else
+        s.add(v);
+      graph.invalidate(v);
+    }
+    checkPaths();
+  }
+
+  void testFlowField() {
+    Rectangle bounds(60, 60);
+    Sectors s(bounds, Table<optional<Vec2>>(bounds));
+    for (Vec2 v : bounds)
+      if (!Random.roll(4))
+        s.add(v);
+    vector<Vec2> targets;
+    while (targets.size() < 2) {
+      Vec2 v = bounds.randomVec2();
+      if (s.contains(v))
+        targets.push_back(v);
+    }
+    FlowField field(bounds, targets, s, [](Vec2) { return 1.0; });
+    for (int i : Range(100)) {
+      Vec2 from = bounds.randomVec2();
+      if (!s.contains(from))
+        continue;
+      auto path = field.getPath(from);
+      CHECK(path.empty() == (!s.same(from, targets[0]) && !s.same(from, targets[1])));
+      if (!path.empty()) {
+        CHECK(path[0] == from && targets.contains(path.back()));
+        ShortestPath exact(bounds, [&](Vec2 v) { return s.contains(v) ? 1 : ShortestPath::infinity; },
+            [&](Vec2 v) { return from.dist8(v); }, Vec2::directions8(), path.back(), from);
+        CHECK(exact.getPath().size() == path.size());
+      }
+    }
+  }
+
+  void testFlowFieldCache() {
+    Rectangle bounds(10, 10);
+    Sectors s(bounds, Table<optional<Vec2>>(bounds));
+    for (Vec2 v : bounds)
+      s.add(v);
+    int numCreated = 0;
+    auto create = [&] { ++numCreated; return FlowField(bounds, {Vec2(0, 0)}, s, [](Vec2) { return 1.0; }); };
+    FlowFieldCache cache;
+    MovementType walk({MovementTrait::WALK});
+    MovementType fly({MovementTrait::FLY});
+    const FlowField* walkField = nullptr;
+    const FlowField* flyField = nullptr;
+    for (int i : Range(3)) {
+      walkField = cache.get({Vec2(0, 0)}, walk, create);
+      flyField = cache.get({Vec2(0, 0)}, fly, create);
+    }
+    CHECK(walkField && flyField && numCreated == 2);
+    // Only the fields of the changed movement type go, and they come back on the next request.
+    cache.clear(walk);
+    CHECK(cache.get({Vec2(0, 0)}, fly, create) == flyField);
+    CHECK(numCreated == 2);
+    CHECK(cache.get({Vec2(0, 0)}, walk, create));
+    CHECK(numCreated == 3);
+  }
+
+  void testBucketQueue() {
+    for (double scale : {1.0, 1000.0})
+      testBucketQueue(scale);
+  }
+
+  // A large scale makes the keys exceed the range of the buckets.
+  void testBucketQueue(double scale) {
+    Rectangle bounds(60, 60);
+    Table<double> costs(bounds, scale);
+    for (Vec2 v : bounds)
+      if (Random.roll(4))
+        costs[v] = ShortestPath::infinity;
+      else if (Random.roll(10))
+        costs[v] = 5 * scale;
+    auto getCost = [&](const vector<Vec2>& path) {
+      double ret = 0;
+      for (int i : Range(path.size() - 1))
+        ret += costs[path[i]];
+      return ret;
+    };
+    for (int i : Range(50)) {
+      Vec2 from = bounds.randomVec2();
+      Vec2 to = bounds.randomVec2();
+      vector<vector<Vec2>> paths;
+      for (bool useBucketQueue : {false, true}) {
+        ShortestPath::useBucketQueue = useBucketQueue;
+        ShortestPath path(bounds, [&](Vec2 v) { return costs[v]; }, [from](Vec2 v) { return from.dist8(v); },
+            Vec2::directions8(), to, from);
+        paths.push_back(path.getPath());
+      }
+      CHECK(paths[0].empty() == paths[1].empty());
+      if (!paths[0].empty())
+        CHECK(getCost(paths[0]) == getCost(paths[1]));
+    }
+  }
+
+  void testDenseSearch() {
+    Rectangle bounds(50, 50);
+    Table<bool> blocked(bounds, false);
+    for (Vec2 v : bounds)
+      blocked[v] = Random.roll(3);
+    Vec2 from = bounds.randomVec2();
+    Table<int> expected(bounds, -1);
+    expected[from] = 0;
+    queue<Vec2> q;
+    q.push(from);
+    while (!q.empty()) {
+      Vec2 pos = q.front();
+      q.pop();
+      for (Vec2 v : pos.neighbors8())
+        if (v.inRectangle(bounds) && !blocked[v] && expected[v] == -1) {
+          expected[v] = expected[pos] + 1;
+          q.push(v);
+        }
+    }
+    BfSearch bfs(bounds, from, [&](Vec2 v) { return !blocked[v]; });
+    Dijkstra dijkstra(bounds, {from}, 10000, [&](Vec2 v) { return blocked[v] ? 10000 : 1; });
+    int numReachable = 0;
+    for (Vec2 v : bounds) {
+      CHECK(bfs.isReachable(v) == (expected[v] > -1));
+      if (expected[v] > -1) {
+        ++numReachable;
+        CHECK(dijkstra.getDist(v) == expected[v]);
+      }
+    }
+    CHECK(bfs.getAllReachable().size() == numReachable);
+    int lastDist = 0;
+    int numVisited = 0;
+    BfSearch::visit(PathfindingContext::forThisThread(), bounds, {from}, 5, [&](Vec2 v) { return !blocked[v]; },
+        [&](Vec2 v, int dist) {
+          CHECK(dist == expected[v]);
+          CHECK(dist >= lastDist && dist <= 5);
+          lastDist = dist;
+          ++numVisited;
+        });
+    for (Vec2 v : bounds)
+      if (expected[v] > -1 && expected[v] <= 5)
+        --numVisited;
+    CHECK(numVisited == 0);
+  }
+
+  void testNavigationCostGrid() {
+    NavigationCostGrid grid(Rectangle(3, 1));
+    CHECK(grid.get(Vec2(0, 0)) == NavigationCostGrid::infinity);
+    grid.set(Vec2(0, 0), 1);
+    grid.set(Vec2(1, 0), 10.5);
+    grid.set(Vec2(2, 0), 1e7);
+    CHECK(grid.isFreeMovement(Vec2(0, 0)) && grid.get(Vec2(0, 0)) == 1);
+    CHECK(!grid.isFreeMovement(Vec2(1, 0)) && grid.get(Vec2(1, 0)) == 10.5);
+    CHECK(grid.get(Vec2(2, 0)) < NavigationCostGrid::infinity);
+    grid.set(Vec2(0, 0), ShortestPath::infinity);
+    CHECK(grid.get(Vec2(0, 0)) == NavigationCostGrid::infinity);
+  }
+
+  void testFieldOfView() {
+    for (int i : Range(20)) {
+      Rectangle bounds(Random.get(1, 80), Random.get(1, 80));
+      Table<bool> blocking(bounds.minusMargin(-1), true);
+      int density = Random.get(2, 10);
+      for (Vec2 v : bounds)
+        blocking[v] = Random.roll(density);
+      for (int j : Range(20)) {
+        Vec2 from = bounds.randomVec2();
+        auto tiles = FieldOfView::computeVisibleTiles(bounds, blocking, from);
+        std::sort(tiles.begin(), tiles.end());
+        CHECK(tiles == FieldOfView::computeVisibleTilesReference(bounds, blocking, from));
+      }
+    }
+  }
+
+  void testTimeQueueSchedule() {
+    // Compares the schedule with the original map of queues on random operations.
+    using ExtendedTime = TimeQueue::ExtendedTime;
+    struct Queue {
+      deque<int> players;
+      deque<int> nonPlayers;
+      bool empty() const { return players.empty() && nonPlayers.empty(); }
+      int front() const { return players.empty() ? nonPlayers.front() : players.front(); }
+    };
+    map<ExtendedTime, Queue> queue;
+    map<int, ExtendedTime> timeMap;
+    map<int, bool> isPlayer;
+    auto getDeque = [&] (int id) -> deque<int>& {
+      auto& q = queue.at(timeMap.at(id));
+      for (auto& d : {&q.players, &q.nonPlayers})
+        if (std::find(d->begin(), d->end(), id) != d->end())
+          return *d;
+      FATAL << "Not found " << id;
+      return q.players;
+    };
+    auto eraseRef = [&] (int id) {
+      auto& d = getDeque(id);
+      d.erase(std::find(d.begin(), d.end(), id));
+    };
+    auto pushRef = [&] (int id, bool front) {
+      auto& q = queue[timeMap.at(id)];
+      auto& d = isPlayer[id] ? q.players : q.nonPlayers;
+      if (front)
+        d.push_front(id);
+      else
+        d.push_back(id);
+    };
+    auto getPosition = [&] (int id) {
+      auto& d = getDeque(id);
+      return make_pair(&d == &queue.at(timeMap.at(id)).players ? 0 : 1, std::find(d.begin(), d.end(), id) - d.begin());
+    };
+    TimeQueue::Schedule schedule;
+    vector<int> ids;
+    int nextId = 0;
+    for (int i : Range(5000)) {
+      int op = Random.get(8);
+      if (ids.empty() || op == 0) {
+        int id = nextId++;
+        ExtendedTime time(LocalTime() +
+            1_visible * (Random.get(3) + (queue.empty() ? 0 : queue.begin()->first.time.getVisibleInt())));
+        isPlayer[id] = Random.roll(4);
+        timeMap[id] = time;
+        pushRef(id, false);
+        schedule.push(id, time, isPlayer[id]);
+        ids.push_back(id);
+        continue;
+      }
+      int id = Random.choose(ids);
+      bool front = false;
+      if (op == 1) {
+        eraseRef(id);
+        schedule.erase(id);
+        ids.removeElementMaybe(id);
+        continue;
+      } else if (op == 2) {
+        eraseRef(id);
+        timeMap.at(id).time += 1_visible * Random.get(1, 3);
+        timeMap.at(id).extraTurn = false;
+      } else if (op == 3) {
+        eraseRef(id);
+        auto& time = timeMap.at(id);
+        if (!time.extraTurn)
+          time.extraTurn = true;
+        else {
+          time.time += 1_visible;
+          time.extraTurn = false;
+        }
+      } else if (op == 4) {
+        eraseRef(id);
+        isPlayer[id] = Random.roll(4);
+      } else if (op == 5) {
+        eraseRef(id);
+        front = true;
+      } else {
+        for (int id1 : ids)
+          if (id1 != id && schedule.willMoveThisTurn(id) && schedule.willMoveThisTurn(id1)) {
+            auto time = timeMap.at(id);
+            auto time1 = timeMap.at(id1);
+            bool before = time < time1 || (time == time1 && getPosition(id) < getPosition(id1));
+            CHECK(schedule.isBefore(id, id1) == before);
+          }
+        continue;
+      }
+      schedule.erase(id);
+      if (front)
+        schedule.pushFront(id, timeMap.at(id), isPlayer[id]);
+      else
+        schedule.push(id, timeMap.at(id), isPlayer[id]);
+      pushRef(id, front);
+      while (!queue.empty() && queue.begin()->second.empty())
+        queue.erase(queue.begin());
+      if (!queue.empty()) {
+        auto nowTime = queue.begin()->first;
+        int expected = queue.begin()->second.front();
+        if (!nowTime.extraTurn) {
+          auto next = ++queue.begin();
+          if (next != queue.end() && next->first.time == nowTime.time && !next->second.players.empty())
+            expected = next->second.players.front();
+        }
+        CHECK(schedule.getNext(1000000) == expected);
+        for (int id1 : ids) {
+          auto time = timeMap.at(id1);
+          CHECK(schedule.willMoveThisTurn(id1) ==
+              (time.time == nowTime.time && (!time.extraTurn || nowTime.extraTurn)));
+        }
+      }
+    }
+  }
+
+  void testRandomStreams() {
+    RandomGen parent;
+    parent.init(1234);
+    int seed1 = parent.getChildSeed(5);
+    for (int i : Range(100))
+      parent.get(10);
+    CHECKEQ(seed1, parent.getChildSeed(5));
+    CHECK(seed1 != parent.getChildSeed(6));
+    RandomGen child1, child2;
+    child1.init(seed1);
+    child2.init(seed1);
+    {
+      RandomGen::Redirect redirect(child1);
+      for (int i : Range(100))
+        CHECKEQ(Random.get(1000), child2.get(1000));
+    }
+    stringstream ss;
+    {
+      OutputArchive output(ss);
+      output(child1);
+    }
+    InputArchive input(ss);
+    RandomGen loaded;
+    input(loaded);
+    for (int i : Range(100))
+      CHECKEQ(loaded.get(1000), child1.get(1000));
+  }
+
+  void testBulkSerialization() {
+    Table<double> table(Rectangle(-3, 2, 40, 30));
+    for (Vec2 v : table.getBounds())
+      table[v] = v.x * 0.25 + v.y;
+    stringstream bulk;
+    {
+      OutputArchive output(bulk);
+      output << table;
+    }
+    stringstream elementwise;
+    {
+      OutputArchive output(elementwise);
+      output << table.getBounds();
+      for (Vec2 v : table.getBounds())
+        output << table[v];
+    }
+    CHECK(bulk.str() == elementwise.str());
+    InputArchive input(bulk);
+    Table<double> loaded(1, 1);
+    input >> loaded;
+    CHECK(loaded.getBounds() == table.getBounds());
+    for (Vec2 v : table.getBounds())
+      CHECKEQ(loaded[v], table[v]);
+    vector<SVec2> points {SVec2{1, -2}, SVec2{300, 4}};
+    stringstream pointStream;
+    {
+      OutputArchive output(pointStream);
+      output << points;
+    }
+    InputArchive pointInput(pointStream);
+    vector<SVec2> loadedPoints;
+    pointInput >> loadedPoints;
+    CHECKEQ(loadedPoints.size(), 2);
+    CHECKEQ(loadedPoints[1].x, 300);
+    CHECKEQ(loadedPoints[0].y, -2);
+  }
+
+  static string makeStreamTestData(int size) {
+    string ret;
+    while (ret.size() < size)
+      ret += toString(Random.get(1000000)) + " ";
+    return ret;
+  }
+
+  static string readCompressedFile(const char* path) {
+    CompressedInputStream in(path);
+    return string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  static long long writeCompressedFile(const char* path, const char* previous, const string& data) {
+    CompressedOutputBuffer buffer(path, previous);
+    std::ostream out(&buffer);
+    out.write(data.data(), data.size());
+    CHECK(buffer.close());
+    return buffer.getNumReusedBytes();
+  }
+
+  void testCompressedStream() {
+    const char* path = "test_stream.gz";
+    // Spans several blocks and ends with a partial one.
+    string data = makeStreamTestData((3 << 20) + 1000);
+    for (int numThreads : {1, 4}) {
+      {
+        CompressedOutputBuffer buffer(path, numThreads);
+        CHECK(buffer.setHeader("header data"));
+        std::ostream out(&buffer);
+        out.write(data.data(), data.size());
+        CHECK(buffer.close());
+      }
+      auto header = readCompressedFileHeader(path);
+      CHECK(header && *header == "header data");
+      CHECK(isCompressedFileValid(path));
+      CHECK(readCompressedFile(path) == data);
+    }
+    stringstream contents;
+    contents << std::ifstream(path, std::ios::binary).rdbuf();
+    std::ofstream(path, std::ios::binary) << contents.str().substr(0, contents.str().size() / 2);
+    CHECK(!isCompressedFileValid(path));
+    remove(path);
+  }
+
+  void testCompressedStreamChunkReuse() {
+    const char* path1 = "test_chunks1.gz";
+    const char* path2 = "test_chunks2.gz";
+    const char* path3 = "test_chunks3.gz";
+    string data1 = makeStreamTestData(3 << 20);
+    string data2 = data1;
+    data2.replace(data2.size() / 2, 8, "modified");
+    // There is no previous file yet, but passing one makes the stream write a chunk index.
+    CHECKEQ(writeCompressedFile(path1, "test_chunks_missing.gz", data1), 0);
+    auto reused = writeCompressedFile(path2, path1, data2);
+    CHECK(reused > 0 && reused < data2.size()) << reused;
+    CHECK(readCompressedFile(path2) == data2);
+    CHECK(isCompressedFileValid(path2));
+    // An index of another version is ignored.
+    {
+      std::ofstream index(getChunkIndexPath(path2), std::ios::binary);
+      OutputArchive archive(index);
+      archive(1);
+    }
+    CHECKEQ(writeCompressedFile(path3, path2, data2), 0);
+    // The previous file was replaced with one of the same size, so no chunk matches its compressed CRC.
+    size_t size = std::ifstream(path1, std::ios::binary | std::ios::ate).tellg();
+    std::ofstream(path1, std::ios::binary) << string(size, 'x');
+    CHECKEQ(writeCompressedFile(path3, path1, data2), 0);
+    CHECK(readCompressedFile(path3) == data2);
+    for (auto path : {path1, path2, path3}) {
+      remove(path);
+      remove(getChunkIndexPath(path).c_str());
+    }
+  }
+
+  void testMemoryCounter() {
+    auto before = MemoryCounter::getTotal(MemoryCategory::SECTORS);
+    {
+      MemoryCounter counter(MemoryCategory::SECTORS);
+      counter.set(1000);
+      CHECKEQ(MemoryCounter::getTotal(MemoryCategory::SECTORS), before + 1000);
+      MemoryCounter copy(counter);
+      CHECKEQ(MemoryCounter::getTotal(MemoryCategory::SECTORS), before + 2000);
+      copy.set(10);
+      CHECKEQ(MemoryCounter::getTotal(MemoryCategory::SECTORS), before + 1010);
+    }
+    CHECKEQ(MemoryCounter::getTotal(MemoryCategory::SECTORS), before);
+  }
+
+  void testPathfindingThreads() {
+    Rectangle bounds(80, 80);
+    Table<double> costs(bounds, 1);
+    for (Vec2 v : bounds)
+      if (Random.roll(4))
+        costs[v] = ShortestPath::infinity;
+    vector<pair<Vec2, Vec2>> queries;
+    for (int i : Range(40))
+      queries.push_back(make_pair(bounds.randomVec2(), bounds.randomVec2()));
+    auto findPaths = [&](int first, int step) {
+      vector<vector<Vec2>> ret;
+      for (int i = first; i < queries.size(); i += step) {
+        Vec2 from = queries[i].first;
+        ShortestPath path(bounds, [&](Vec2 v) { return costs[v]; }, [from](Vec2 v) { return from.dist8(v); },
+            Vec2::directions8(), queries[i].second, from);
+        ret.push_back(path.getPath());
+      }
+      return ret;
+    };
+    auto expected = findPaths(0, 1);
+    const int numThreads = 4;
+    vector<vector<vector<Vec2>>> results(numThreads);
+    vector<thread> threads;
+    for (int i : Range(numThreads))
+      threads.push_back(makeThread([&, i] {
+        PathfindingContext::forThisThread().logging = false;
+        results[i] = findPaths(i, numThreads);
+      }));
+    for (auto& t : threads)
+      t.join();
+    for (int i : All(queries))
+      CHECK(results[i % numThreads][i / numThreads] == expected[i]);
+  }
+
   void testReverse() {
     vector<int> v1 {1, 2, 3, 4};
     vector<int> v2 {4, 3, 2, 1};
@@ -1352,6 +1860,20 @@ void testAll() {
   Test().testSectors2();
   Test().testSectors3();
   Test().testSectorsWithPortals();
+  Test().testClusterGraph();
+  Test().testFlowField();
+  Test().testFlowFieldCache();
+  Test().testBucketQueue();
+  Test().testDenseSearch();
+  Test().testNavigationCostGrid();
+  Test().testFieldOfView();
+  Test().testTimeQueueSchedule();
+  Test().testRandomStreams();
+  Test().testMemoryCounter();
+  Test().testBulkSerialization();
+  Test().testCompressedStream();
+  Test().testCompressedStreamChunkReuse();
+  Test().testPathfindingThreads();
   Test().testReverse();
   Test().testReverse2();
   Test().testReverse3();
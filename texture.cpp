@@ -52,6 +52,7 @@ Texture::Texture(Color color, int width, int height) {
   CHECK_OPENGL_ERROR();
 
   realSize = size = Vec2(width, height);
+  memoryCounter.set(width * height * 4);
   SDL::glBindTexture(GL_TEXTURE_2D, 0);
 }
 
@@ -87,6 +88,8 @@ Texture& Texture::operator=(Texture&& tex) {
   texId = std::move(tex.texId);
   path = tex.path;
   tex.texId = none;
+  memoryCounter = tex.memoryCounter;
+  tex.memoryCounter.set(0);
   return *this;
 }
 
@@ -119,6 +122,7 @@ optional<SDL::GLenum> Texture::loadFromMaybe(SDL::SDL_Surface* imageOrig) {
   SDL::glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->w, image->h, 0, mode, GL_UNSIGNED_BYTE, image->pixels);
   size = Vec2(imageOrig->w, imageOrig->h);
   realSize = Vec2(image->w, image->h);
+  memoryCounter.set(image->w * image->h * 4);
   if (image != imageOrig)
     SDL::SDL_FreeSurface(image);
   auto error = SDL::glGetError();
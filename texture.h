@@ -20,6 +20,7 @@
 #include "sdl.h"
 #include "color.h"
 #include "file_path.h"
+#include "memory_telemetry.h"
 
 class Texture {
   public:
@@ -64,4 +65,5 @@ class Texture {
   Vec2 size;
   Vec2 realSize;
   optional<FilePath> path;
+  MemoryCounter memoryCounter {MemoryCategory::TEXTURES};
 };
@@ -19,135 +19,133 @@
 #include "creature.h"
 #include "view_object.h"
 
-template <class Archive> 
-void TimeQueue::serialize(Archive& ar, const unsigned int version) { 
+template <class Archive>
+void TimeQueue::serialize(Archive& ar, const unsigned int version) {
+  SavedState state;
+  if (!Archive::is_loading::value) {
+    compactCreatures();
+    state = getSavedState();
+  }
+  auto& timeMap = state.timeMap;
+  auto& queue = state.queue;
   ar(creatures, timeMap, queue);
+  if (Archive::is_loading::value)
+    loadSavedState(state);
 }
 
 SERIALIZABLE(TimeQueue);
 
-void TimeQueue::addCreature(PCreature c, LocalTime time) {
-  timeMap.set(c.get(), time);
-  queue[time].push(c.get());
-  creatures.push_back(std::move(c));
-}
-
-LocalTime TimeQueue::getTime(const Creature* c) {
-  return timeMap.getOrFail(c).time;
-}
-
-static void clearNull(deque<Creature*>& q) {
-  while (!q.empty() && q.back() == nullptr)
-    q.pop_back();
-  while (!q.empty() && q.front() == nullptr)
-    q.pop_front();
-}
-
-void TimeQueue::Queue::clearNull() {
-  ::clearNull(players);
-  ::clearNull(nonPlayers);
-}
-
-void TimeQueue::Queue::push(Creature* c) {
-  clearNull();
-  if (c->isPlayer()) {
-    int order = players.empty() ? 0 : orderMap.getOrFail(players.back()) + 1;
-    orderMap.set(c, order);
-    players.push_back(c);
-  } else {
-    int order = nonPlayers.empty() ? 1000000000 : orderMap.getOrFail(nonPlayers.back()) + 1;
-    orderMap.set(c, order);
-    nonPlayers.push_back(c);
+TimeQueue::SavedState TimeQueue::getSavedState() const {
+  SavedState ret;
+  for (auto& entry : schedule.getEntries()) {
+    auto c = handleInfo[entry.handle].creature;
+    ret.timeMap.set(c, entry.time);
+    auto& queue = ret.queue[entry.time];
+    if (entry.player) {
+      queue.orderMap.set(c, queue.players.size());
+      queue.players.push_back(c);
+    } else {
+      queue.orderMap.set(c, 1000000000 + queue.nonPlayers.size());
+      queue.nonPlayers.push_back(c);
+    }
   }
+  // Keeps the current turn when it has no creatures left.
+  if (auto time = schedule.getCurrentTime())
+    ret.queue[*time];
+  return ret;
 }
 
-void TimeQueue::Queue::pushFront(Creature* c) {
-  clearNull();
-  if (c->isPlayer()) {
-    int order = players.empty() ? 0 : orderMap.getOrFail(players.front()) - 1;
-    orderMap.set(c, order);
-    players.push_front(c);
-  } else {
-    int order = nonPlayers.empty() ? 1000000000 : orderMap.getOrFail(nonPlayers.front()) - 1;
-    orderMap.set(c, order);
-    nonPlayers.push_front(c);
+void TimeQueue::loadSavedState(const SavedState& state) {
+  handles.clear();
+  handleInfo.clear();
+  freeHandles.clear();
+  numRemoved = 0;
+  vector<Schedule::Entry> entries;
+  for (int i : All(creatures)) {
+    auto c = creatures[i].get();
+    handles.set(c, handleInfo.size());
+    handleInfo.push_back(HandleInfo{c, i});
   }
+  for (auto& elem : state.queue) {
+    for (auto c : elem.second.players)
+      if (c)
+        entries.push_back(Schedule::Entry{getHandle(c), elem.first, true, elem.second.orderMap.getOrFail(c)});
+    for (auto c : elem.second.nonPlayers)
+      if (c)
+        entries.push_back(Schedule::Entry{getHandle(c), elem.first, false, elem.second.orderMap.getOrFail(c)});
+  }
+  schedule.setEntries(entries);
+  if (!state.queue.empty())
+    schedule.setCurrentTime(state.queue.begin()->first);
 }
 
-bool TimeQueue::Queue::empty() {
-  clearNull();
-  return players.empty() && nonPlayers.empty();
-}
-
-Creature* TimeQueue::Queue::front() {
-  clearNull();
-  if (!players.empty())
-    return players.front();
-  else
-    return nonPlayers.front();
+int TimeQueue::getHandle(const Creature* c) const {
+  return handles.getOrFail(c);
 }
 
-void TimeQueue::Queue::popFront() {
-  if (!players.empty())
-    return players.pop_front();
-  else
-    return nonPlayers.pop_front();
+void TimeQueue::addCreature(PCreature c, LocalTime time) {
+  int handle;
+  if (!freeHandles.empty()) {
+    handle = freeHandles.back();
+    freeHandles.pop_back();
+  } else {
+    handle = handleInfo.size();
+    handleInfo.emplace_back();
+  }
+  handleInfo[handle] = HandleInfo{c.get(), creatures.size()};
+  handles.set(c.get(), handle);
+  schedule.push(handle, time, c->isPlayer());
+  creatures.push_back(std::move(c));
 }
 
-void TimeQueue::Queue::erase(Creature* c) {
-  auto eraseFrom = [&c] (deque<Creature*>& queue) {
-    for (int i : All(queue))
-      if (queue[i] == c) {
-        queue[i] = nullptr;
-        return true;
-      }
-    return false;
-  };
-  CHECK(eraseFrom(players) || eraseFrom(nonPlayers));
+LocalTime TimeQueue::getTime(const Creature* c) {
+  return schedule.getTime(getHandle(c)).time;
 }
 
 void TimeQueue::increaseTime(Creature* c, TimeInterval diff) {
-  auto& time = timeMap.getOrFail(c);
-  queue.at(time).erase(c);
+  int handle = getHandle(c);
+  auto time = schedule.getTime(handle);
+  schedule.erase(handle);
   time.time += diff;
   time.extraTurn = false;
-  queue[time].push(c);
+  schedule.push(handle, time, c->isPlayer());
 }
 
 void TimeQueue::makeExtraMove(Creature* c) {
-  auto& time = timeMap.getOrFail(c);
-  queue.at(time).erase(c);
+  int handle = getHandle(c);
+  auto time = schedule.getTime(handle);
+  schedule.erase(handle);
   if (!time.extraTurn)
     time.extraTurn = true;
   else {
     time.time += 1_visible;
     time.extraTurn = false;
   }
-  queue[time].push(c);
+  schedule.push(handle, time, c->isPlayer());
 }
 
 bool TimeQueue::hasExtraMove(Creature* c) {
-  return timeMap.getOrFail(c).extraTurn;
+  return schedule.getTime(getHandle(c)).extraTurn;
 }
 
 void TimeQueue::postponeMove(Creature* c) {
   CHECK(contains(c));
-  auto time = timeMap.getOrFail(c);
-  queue.at(time).erase(c);
-  queue.at(time).push(c);
+  int handle = getHandle(c);
+  auto time = schedule.getTime(handle);
+  schedule.erase(handle);
+  schedule.push(handle, time, c->isPlayer());
 }
 
 void TimeQueue::moveNow(Creature* c) {
   CHECK(contains(c));
-  auto time = timeMap.getOrFail(c);
-  queue.at(time).erase(c);
-  queue.at(time).pushFront(c);
+  int handle = getHandle(c);
+  auto time = schedule.getTime(handle);
+  schedule.erase(handle);
+  schedule.pushFront(handle, time, c->isPlayer());
 }
 
 bool TimeQueue::willMoveThisTurn(const Creature* c) {
-  auto hisTime = timeMap.getOrFail(c);
-  auto curTime = queue.begin()->first;
-  return hisTime.time == curTime.time && (!hisTime.extraTurn || curTime.extraTurn);
+  return schedule.willMoveThisTurn(getHandle(c));
 }
 
 bool TimeQueue::compareOrder(const Creature* c1, const Creature* c2) {
@@ -157,62 +155,57 @@ bool TimeQueue::compareOrder(const Creature* c1, const Creature* c2) {
     return false;
   if (!willMoveThisTurn(c1))
     return c1->getLastMoveCounter() < c2->getLastMoveCounter();
-  auto time1 = timeMap.getOrFail(c1);
-  auto time2 = timeMap.getOrFail(c2);
-  if (time1 < time2)
-    return true;
-  if (time2 < time1)
-    return false;
-  auto& orderMap = queue.at(time1).orderMap;
-  return orderMap.getOrFail(c1) < orderMap.getOrFail(c2);
+  return schedule.isBefore(getHandle(c1), getHandle(c2));
 }
 
-bool TimeQueue::contains(Creature* c) const {
-  for (auto& creature : creatures)
-    if (creature.get() == c)
-      return true;
-  return false;
+bool TimeQueue::contains(const Creature* c) const {
+  return handles.hasKey(c);
 }
 
 TimeQueue::TimeQueue() {}
 
-PCreature TimeQueue::removeCreature(Creature* cRef) {
-  for (int i : All(creatures))
-    if (creatures[i].get() == cRef) {
-      queue.at(timeMap.getOrFail(cRef)).erase(cRef);
-      PCreature ret = std::move(creatures[i]);
-      creatures.removeIndexPreserveOrder(i);
-      return ret;
+void TimeQueue::compactCreatures() {
+  if (numRemoved == 0)
+    return;
+  vector<PCreature> remaining;
+  for (auto& c : creatures)
+    if (c) {
+      handleInfo[getHandle(c.get())].index = remaining.size();
+      remaining.push_back(std::move(c));
     }
-  FATAL << "Creature not found";
-  return nullptr;
+  creatures = std::move(remaining);
+  numRemoved = 0;
+}
+
+PCreature TimeQueue::removeCreature(Creature* cRef) {
+  if (!contains(cRef))
+    FATAL << "Creature not found";
+  int handle = getHandle(cRef);
+  schedule.erase(handle);
+  handles.erase(cRef);
+  freeHandles.push_back(handle);
+  PCreature ret = std::move(creatures[handleInfo[handle].index]);
+  ++numRemoved;
+  if (numRemoved > creatures.size() / 2)
+    compactCreatures();
+  return ret;
 }
 
 vector<Creature*> TimeQueue::getAllCreatures() const {
-  return getWeakPointers(creatures);
+  vector<Creature*> ret;
+  ret.reserve(creatures.size() - numRemoved);
+  for (auto& c : creatures)
+    if (c)
+      ret.push_back(c.get());
+  return ret;
 }
 
 Creature* TimeQueue::getNextCreature(double maxTime) {
-  if (creatures.empty())
+  if (creatures.size() == numRemoved)
     return nullptr;
-  while (1) {
-    CHECK(!queue.empty());
-    if (!queue.begin()->second.empty())
-      break;
-    queue.erase(queue.begin());
-  }
-  auto nowTime = queue.begin()->first;
-  if (nowTime.getDouble() > maxTime)
-    return nullptr;
-  auto& q = queue.begin()->second;
-  if (!nowTime.extraTurn) {
-    auto nextQueue = ++queue.begin();
-    if (nextQueue != queue.end()) {
-      if (nextQueue->first.time == nowTime.time && !nextQueue->second.empty() && nextQueue->second.front()->isPlayer())
-        return nextQueue->second.front();
-    }
-  }
-  return q.front();
+  if (auto handle = schedule.getNext(maxTime))
+    return handleInfo[*handle].creature;
+  return nullptr;
 }
 
 TimeQueue::ExtendedTime::ExtendedTime() {}
@@ -229,3 +222,149 @@ double TimeQueue::ExtendedTime::getDouble() const {
 bool TimeQueue::ExtendedTime::operator < (TimeQueue::ExtendedTime o) const {
   return time < o.time || (time == o.time && !extraTurn && o.extraTurn);
 }
+
+bool TimeQueue::ExtendedTime::operator == (TimeQueue::ExtendedTime o) const {
+  return time == o.time && extraTurn == o.extraTurn;
+}
+
+bool TimeQueue::Schedule::Node::operator < (const Node& o) const {
+  if (time < o.time)
+    return true;
+  if (o.time < time)
+    return false;
+  if (player != o.player)
+    return player;
+  return order < o.order;
+}
+
+void TimeQueue::Schedule::push(int handle, ExtendedTime time, bool player) {
+  insert(handle, Node{time, player, nextBackOrder++});
+}
+
+void TimeQueue::Schedule::pushFront(int handle, ExtendedTime time, bool player) {
+  insert(handle, Node{time, player, nextFrontOrder--});
+}
+
+void TimeQueue::Schedule::insert(int handle, Node node) {
+  if (handle >= nodes.size())
+    nodes.resize(handle + 1);
+  CHECK(nodes[handle].heapIndex == -1);
+  if (!currentTime || node.time < *currentTime)
+    currentTime = node.time;
+  node.heapIndex = heap.size();
+  nodes[handle] = node;
+  heap.push_back(handle);
+  siftUp(node.heapIndex);
+  if (node.player)
+    players.insert(make_pair(node, handle));
+}
+
+void TimeQueue::Schedule::erase(int handle) {
+  auto& node = nodes[handle];
+  int index = node.heapIndex;
+  CHECK(index >= 0);
+  if (node.player)
+    players.erase(make_pair(node, handle));
+  swapNodes(index, heap.size() - 1);
+  heap.pop_back();
+  node.heapIndex = -1;
+  if (index < heap.size()) {
+    siftUp(index);
+    siftDown(index);
+  }
+}
+
+TimeQueue::ExtendedTime TimeQueue::Schedule::getTime(int handle) const {
+  return nodes[handle].time;
+}
+
+bool TimeQueue::Schedule::less(int index1, int index2) const {
+  return nodes[heap[index1]] < nodes[heap[index2]];
+}
+
+void TimeQueue::Schedule::swapNodes(int index1, int index2) {
+  std::swap(heap[index1], heap[index2]);
+  nodes[heap[index1]].heapIndex = index1;
+  nodes[heap[index2]].heapIndex = index2;
+}
+
+void TimeQueue::Schedule::siftUp(int index) {
+  while (index > 0 && less(index, (index - 1) / 2)) {
+    swapNodes(index, (index - 1) / 2);
+    index = (index - 1) / 2;
+  }
+}
+
+void TimeQueue::Schedule::siftDown(int index) {
+  while (1) {
+    int smallest = index;
+    for (int child : {2 * index + 1, 2 * index + 2})
+      if (child < heap.size() && less(child, smallest))
+        smallest = child;
+    if (smallest == index)
+      return;
+    swapNodes(index, smallest);
+    index = smallest;
+  }
+}
+
+optional<int> TimeQueue::Schedule::getNext(double maxTime) {
+  CHECK(!heap.empty());
+  auto nowTime = nodes[heap[0]].time;
+  currentTime = nowTime;
+  if (nowTime.getDouble() > maxTime)
+    return none;
+  // A player with an extra move goes before the others at the same time.
+  if (!nowTime.extraTurn) {
+    ExtendedTime extraTime = nowTime;
+    extraTime.extraTurn = true;
+    auto it = players.lower_bound(make_pair(Node{extraTime, true, std::numeric_limits<long long>::min()}, -1));
+    if (it != players.end() && it->first.time == extraTime)
+      return it->second;
+  }
+  return heap[0];
+}
+
+bool TimeQueue::Schedule::willMoveThisTurn(int handle) const {
+  auto hisTime = nodes[handle].time;
+  auto curTime = *currentTime;
+  return hisTime.time == curTime.time && (!hisTime.extraTurn || curTime.extraTurn);
+}
+
+bool TimeQueue::Schedule::isBefore(int handle1, int handle2) const {
+  return nodes[handle1] < nodes[handle2];
+}
+
+vector<TimeQueue::Schedule::Entry> TimeQueue::Schedule::getEntries() const {
+  vector<Entry> ret;
+  for (int handle : heap) {
+    auto& node = nodes[handle];
+    ret.push_back(Entry{handle, node.time, node.player, node.order});
+  }
+  std::sort(ret.begin(), ret.end(), [this](const Entry& e1, const Entry& e2) {
+      return nodes[e1.handle] < nodes[e2.handle]; });
+  return ret;
+}
+
+void TimeQueue::Schedule::setEntries(const vector<Entry>& entries) {
+  nodes.clear();
+  heap.clear();
+  players.clear();
+  nextBackOrder = 0;
+  nextFrontOrder = -1;
+  for (auto& entry : entries) {
+    nextBackOrder = max(nextBackOrder, entry.order + 1);
+    nextFrontOrder = min(nextFrontOrder, entry.order - 1);
+  }
+  for (auto& entry : entries)
+    insert(entry.handle, Node{entry.time, entry.player, entry.order});
+  currentTime = none;
+}
+
+optional<TimeQueue::ExtendedTime> TimeQueue::Schedule::getCurrentTime() const {
+  return currentTime;
+}
+
+void TimeQueue::Schedule::setCurrentTime(optional<ExtendedTime> time) {
+  currentTime = time;
+}
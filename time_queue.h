@@ -42,35 +42,94 @@ class TimeQueue {
   template <class Archive>
   void serialize(Archive& ar, const unsigned int version);
 
+  struct ExtendedTime {
+    ExtendedTime();
+    ExtendedTime(LocalTime);
+    double getDouble() const;
+    bool operator < (ExtendedTime) const;
+    bool operator == (ExtendedTime) const;
+    LocalTime SERIAL(time);
+    bool SERIAL(extraTurn) = false;
+    SERIALIZE_ALL(time, extraTurn)
+  };
+
+  /** Turn order as an indexed binary heap of handles. Within one time players go first, then each group
+      keeps the order in which its members were pushed to the back or to the front.*/
+  class Schedule {
+    public:
+    void push(int handle, ExtendedTime, bool player);
+    void pushFront(int handle, ExtendedTime, bool player);
+    void erase(int handle);
+    ExtendedTime getTime(int handle) const;
+    /** Returns the handle that moves next, unless its time is later than maxTime.*/
+    optional<int> getNext(double maxTime);
+    bool willMoveThisTurn(int handle) const;
+    /** Compares the handles by time and then by order within the time.*/
+    bool isBefore(int handle1, int handle2) const;
+
+    struct Entry {
+      int handle;
+      ExtendedTime time;
+      bool player;
+      long long order;
+    };
+    /** Returns all elements in turn order.*/
+    vector<Entry> getEntries() const;
+    void setEntries(const vector<Entry>&);
+    optional<ExtendedTime> getCurrentTime() const;
+    void setCurrentTime(optional<ExtendedTime>);
+
+    private:
+    struct Node {
+      ExtendedTime time;
+      bool player;
+      long long order;
+      int heapIndex = -1;
+      bool operator < (const Node&) const;
+    };
+    void insert(int handle, Node);
+    bool less(int heapIndex1, int heapIndex2) const;
+    void swapNodes(int heapIndex1, int heapIndex2);
+    void siftUp(int heapIndex);
+    void siftDown(int heapIndex);
+    vector<Node> nodes;
+    vector<int> heap;
+    // Players waiting for a turn, so that one with an extra move can be found without scanning the heap.
+    set<pair<Node, int>> players;
+    long long nextBackOrder = 0;
+    long long nextFrontOrder = -1;
+    // The earliest time that has been scheduled since the last turn, which counts as the current turn.
+    optional<ExtendedTime> currentTime;
+  };
+
   private:
-  bool contains(Creature*) const;
+  bool contains(const Creature*) const;
+  int getHandle(const Creature*) const;
+  void compactCreatures();
 
+  // Removed creatures leave a null, until there are too many of them.
   vector<PCreature> SERIAL(creatures);
+  int numRemoved = 0;
+  EntityMap<Creature, int> handles;
+  struct HandleInfo {
+    Creature* creature;
+    int index;
+  };
+  vector<HandleInfo> handleInfo;
+  vector<int> freeHandles;
+  Schedule schedule;
+
+  // The format of the save files, which store a queue per time.
   struct Queue {
-    void push(Creature*);
-    void pushFront(Creature*);
-    bool empty();
-    Creature* front();
-    void popFront();
-    void erase(Creature*);
     deque<Creature*> SERIAL(players);
     deque<Creature*> SERIAL(nonPlayers);
     EntityMap<Creature, int> SERIAL(orderMap);
     SERIALIZE_ALL(players, nonPlayers, orderMap)
-
-    private:
-    void clearNull();
   };
-  struct ExtendedTime {
-    ExtendedTime();
-    ExtendedTime(LocalTime);
-    double getDouble() const;
-    bool operator < (ExtendedTime) const;
-    LocalTime SERIAL(time);
-    bool SERIAL(extraTurn) = false;
-    SERIALIZE_ALL(time, extraTurn)
+  struct SavedState {
+    map<ExtendedTime, Queue> SERIAL(queue);
+    EntityMap<Creature, ExtendedTime> SERIAL(timeMap);
   };
-  map<ExtendedTime, Queue> SERIAL(queue);
-  EntityMap<Creature, ExtendedTime> SERIAL(timeMap);
+  SavedState getSavedState() const;
+  void loadSavedState(const SavedState&);
 };
-
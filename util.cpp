@@ -19,13 +19,31 @@
 #include "position.h"
 #include <time.h>
 
+// Set on threads that simulate a part of the game with its own random stream.
+static thread_local RandomGen* globalRedirect = nullptr;
+
 RandomGen::RandomGen() {
   PROFILE;
 }
 
-void RandomGen::init(int seed) {
+void RandomGen::init(int s) {
   PROFILE;
-  generator.seed(seed);
+  if (this == &Random && globalRedirect)
+    globalRedirect->init(s);
+  else {
+    seed = s;
+    generator.seed(s);
+  }
+}
+
+int RandomGen::getChildSeed(long long key) const {
+  // SplitMix64 finalizer, so that neighboring keys give unrelated seeds.
+  uint64_t z = (uint64_t(uint32_t(seed)) << 32) ^ uint64_t(key);
+  z += 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  return int(z & 0x7fffffff);
 }
 
 int RandomGen::get(int max) {
@@ -33,7 +51,7 @@ int RandomGen::get(int max) {
 }
 
 long long RandomGen::getLL() {
-  return uniform_int_distribution<long long>(-(1LL << 62), 1LL << 62)(generator);
+  return uniform_int_distribution<long long>(-(1LL << 62), 1LL << 62)(getGenerator());
 }
 
 int RandomGen::get(Range r) {
@@ -42,7 +60,7 @@ int RandomGen::get(Range r) {
 
 int RandomGen::get(int min, int max) {
   CHECK(max > min);
-  return uniform_int_distribution<int>(min, max - 1)(generator);
+  return uniform_int_distribution<int>(min, max - 1)(getGenerator());
 }
 
 std::string operator "" _s(const char* str, size_t) { 
@@ -90,11 +108,11 @@ bool RandomGen::chance(float v) {
 }
 
 double RandomGen::getDouble() {
-  return defaultDist(generator);
+  return defaultDist(getGenerator());
 }
 
 double RandomGen::getDouble(double a, double b) {
-  return uniform_real_distribution<double>(a, b)(generator);
+  return uniform_real_distribution<double>(a, b)(getGenerator());
 }
 
 pair<float, float> RandomGen::getFloat2Fast() {
@@ -106,7 +124,7 @@ pair<float, float> RandomGen::getFloat2Fast() {
 }
 
 float RandomGen::getFloat(float a, float b) {
-  return uniform_real_distribution<float>(a, b)(generator);
+  return uniform_real_distribution<float>(a, b)(getGenerator());
 }
 
 float RandomGen::getFloatFast(float a, float b) {
@@ -116,6 +134,43 @@ float RandomGen::getFloatFast(float a, float b) {
 
 RandomGen Random;
 
+RandomGen* RandomGen::redirectGlobal(RandomGen* gen) {
+  auto ret = globalRedirect;
+  globalRedirect = gen;
+  return ret;
+}
+
+RandomGen::Redirect::Redirect(RandomGen& gen) : previous(redirectGlobal(&gen)) {
+}
+
+RandomGen::Redirect::~Redirect() {
+  redirectGlobal(previous);
+}
+
+template <class Archive>
+void RandomGen::serialize(Archive& ar, const unsigned int) {
+  string state;
+  if (!Archive::is_loading::value) {
+    stringstream ss;
+    ss << generator;
+    state = ss.str();
+  }
+  ar(seed, state);
+  if (Archive::is_loading::value) {
+    stringstream ss(state);
+    ss >> generator;
+    CHECK(!!ss) << "Bad random generator state";
+  }
+}
+
+SERIALIZABLE(RandomGen);
+
+std::mt19937& RandomGen::getGenerator() {
+  if (globalRedirect && this == &Random)
+    return globalRedirect->generator;
+  return generator;
+}
+
 template string toString<int>(const int&);
 template string toString<unsigned int>(const unsigned int&);
 //template string toString<size_t>(const size_t&);
@@ -131,6 +131,9 @@ struct SVec2 {
   SERIALIZE_ALL(x, y)
 };
 
+template <>
+struct IsBulkSerializable<SVec2> : std::true_type {};
+
 class Vec2 {
   public:
   int SERIAL(x); // HASH(x)
@@ -496,8 +499,7 @@ void serialize(Archive& ar1, EnumMap<Enum, U>& m) {
   ar1(size);
   if (size > EnumInfo<Enum>::size)
     throw ::cereal::Exception("EnumMap larger than legal enum range");
-  for (int i : Range(size))
-    ar1(m[Enum(i)]);
+  serializeArray(ar1, m.elems.data(), size);
 }
 
 #ifdef MEM_USAGE_TEST
@@ -780,13 +782,13 @@ class RandomGen {
 
   template <typename T>
   vector<T> permutation(vector<T> v) {
-    std::shuffle(v.begin(), v.end(), generator);
+    std::shuffle(v.begin(), v.end(), getGenerator());
     return v;
   }
 
   template <typename Iterator>
   void shuffle(Iterator begin, Iterator end) {
-    std::shuffle(begin, end, generator);
+    std::shuffle(begin, end, getGenerator());
   }
 
   template <typename T>
@@ -835,8 +837,31 @@ class RandomGen {
     return chooseImpl(std::forward<T>(first), 2, std::forward<T>(second), std::forward<Args>(rest)...);
   }
 
+  /** Returns a seed for an independent child stream. It depends only on this generator's seed and the key,
+      not on how many numbers were drawn so far.*/
+  int getChildSeed(long long key) const;
+
+  /** Makes the global Random draw from another generator on the current thread. Pass nullptr to undo.
+      Returns the previous redirection.*/
+  static RandomGen* redirectGlobal(RandomGen*);
+
+  /** Redirects the global Random to the given generator until the end of the scope.*/
+  class Redirect {
+    public:
+    Redirect(RandomGen&);
+    ~Redirect();
+
+    private:
+    RandomGen* previous;
+  };
+
+  template <class Archive>
+  void serialize(Archive&, const unsigned int);
+
   private:
+  std::mt19937& getGenerator();
   std::mt19937 generator;
+  int seed = std::mt19937::default_seed;
   std::uniform_real_distribution<double> defaultDist;
 
   template <typename T>
@@ -954,11 +979,11 @@ class Table {
     return mem[(vAbs.x - bounds.px) * bounds.h + vAbs.y - bounds.py];
   }
 
+  // The elements are stored in the order of iterating over the bounds.
   template <class Archive>
   void save(Archive& ar, const unsigned int version) const {
     ar << bounds;
-    for (Vec2 v : bounds)
-      ar << (*this)[v];
+    serializeArray(ar, mem.get(), bounds.width() * bounds.height());
   }
 
 #ifdef MEM_USAGE_TEST
@@ -973,8 +998,7 @@ class Table {
   void load(Archive& ar, const unsigned int version) {
     ar >> bounds;
     mem.reset(new T[bounds.width() * bounds.height()]);
-    for (Vec2 v : bounds)
-      ar >> (*this)[v];
+    serializeArray(ar, mem.get(), bounds.width() * bounds.height());
   }
 
   SERIALIZATION_CONSTRUCTOR(Table)
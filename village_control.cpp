@@ -252,12 +252,17 @@ void VillageControl::acceptImmigration() {
     collective->getImmigration().setAutoState(i, ImmigrantAutoState::AUTO_ACCEPT);
 }
 
-void VillageControl::healAllCreatures() {
+// Returns the chance that an event with the given chance per turn happens at least once in a number of turns.
+static double getChanceInTurns(double chance, int numTurns) {
+  return 1 - pow(1 - min(1.0, chance), numTurns);
+}
+
+void VillageControl::healAllCreatures(int numTurns) {
   PROFILE;
-  const double freq = 0.1;
+  const double freq = getChanceInTurns(0.1, numTurns);
   if (Random.chance(freq))
     for (auto c : collective->getCreatures())
-      c->heal(0.002 / freq);
+      c->heal(0.002 * numTurns / freq);
 }
 
 bool VillageControl::isEnemy() const {
@@ -267,10 +272,18 @@ bool VillageControl::isEnemy() const {
 }
 
 void VillageControl::update(bool currentlyActive) {
+  update(currentlyActive, 1);
+}
+
+void VillageControl::updateRemote(int numTurns) {
+  update(false, numTurns);
+}
+
+void VillageControl::update(bool currentlyActive, int numTurns) {
   considerWelcomeMessage();
   considerCancellingAttack();
   acceptImmigration();
-  healAllCreatures();
+  healAllCreatures(numTurns);
   for (auto& c : collective->getCreatures(MinionTrait::FIGHTER))
     if (c->getBody().isHumanoid())
       if (!c->isAffected(LastingEffect::BRIDGE_BUILDING_SKILL))
@@ -284,11 +297,11 @@ void VillageControl::update(bool currentlyActive) {
       }
     return;
   }
-  double updateFreq = 0.1;
+  double updateFreq = getChanceInTurns(0.1, numTurns);
   if (isEnemy() && canPerformAttack(currentlyActive) && Random.chance(updateFreq) && behaviour) {
     if (Collective* enemy = getEnemyCollective())
       maxEnemyPower = max(maxEnemyPower, enemy->getDangerLevel());
-    double prob = behaviour->getAttackProbability(this) / updateFreq;
+    double prob = getChanceInTurns(behaviour->getAttackProbability(this), numTurns) / updateFreq;
     if (Random.chance(prob)) {
       vector<Creature*> fighters = collective->getCreatures(MinionTrait::FIGHTER).filter([&](auto c) {
         return collective->getTeams().getContaining(c).empty() && !c->isAffected(LastingEffect::INSANITY);
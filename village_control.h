@@ -40,6 +40,7 @@ class VillageControl : public CollectiveControl, public EventListener<VillageCon
 
   protected:
   virtual void update(bool currentlyActive) override;
+  virtual void updateRemote(int numTurns) override;
   virtual void onMemberKilled(const Creature* victim, const Creature* killer) override;
   virtual void onOtherKilled(const Creature* victim, const Creature* killer) override;
   virtual void onRansomPaid() override;
@@ -65,7 +66,8 @@ class VillageControl : public CollectiveControl, public EventListener<VillageCon
   map<TeamId, int> SERIAL(attackSizes);
   bool SERIAL(entries) = false;
   double SERIAL(maxEnemyPower) = 0;
-  void healAllCreatures();
+  void healAllCreatures(int numTurns);
+  void update(bool currentlyActive, int numTurns);
   bool isEnemy() const;
 };
 